@@ -0,0 +1,455 @@
+// ABCU advising benchmarks
+// - Generates a synthetic catalog: course count, prerequisite fan-out,
+//   quoted-field density and malformed-line ratio are all configurable
+// - Times parseCSVLine, loadCoursesFromFile, printSortedCourseList and printCourseInfo,
+//   builds and searches of the title index, validateCatalog, and exportCatalog in each format
+// - Repeats lookups of a small hot set with and without CourseInfoCache
+// - Reports throughput, latency percentiles and heap allocations per operation
+// - Writes one JSON document to stdout so runs can be diffed for regressions
+//
+// Build: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// Run:   ./bench [--courses N] [--fanout K] [--quoted R] [--malformed R] [--reps N] [--queries N] [--seed S]
+
+#include "catalog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Every heap allocation in the process, counted by the replaced operator new
+static std::atomic<uint64_t> gAllocations{0};
+
+void* operator new(std::size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size != 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC pairs the free() with the default operator new once this is inlined
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Shape of the generated catalog and of the run
+struct BenchConfig {
+    size_t courses = 100000;
+    size_t fanout = 3;       // prerequisites per course: uniform in 0..fanout
+    double quoted = 0.1;     // share of titles written as quoted fields (with commas or "" escapes)
+    double malformed = 0.02; // share of lines that are skipped or warned about
+    size_t reps = 5;         // timed loads and listings
+    size_t queries = 100000; // timed course lookups
+    uint32_t seed = 1;
+};
+
+// Synthetic catalog text plus IDs to query
+struct GeneratedCatalog {
+    std::string csv;
+    std::vector<std::string> lines; // csv split into lines, for parseCSVLine
+    std::vector<std::string> ids;   // every defined course ID
+};
+
+static GeneratedCatalog generateCatalog(const BenchConfig& config) {
+    static const char* const kDepartments[] = {"CSCI", "MATH", "PHYS", "ENGL", "CHEM", "BIOL", "HIST", "ECON"};
+    static const char* const kWords[] = {"Intro", "to", "Data", "Structures", "Systems", "Theory", "Applied",
+                                         "Advanced", "Methods", "Analysis", "Design", "Networks"};
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    GeneratedCatalog out;
+    out.ids.reserve(config.courses);
+    for (size_t i = 0; i < config.courses; ++i) {
+        out.ids.push_back(std::string(kDepartments[i % 8]) + std::to_string(100 + i / 8));
+    }
+    for (size_t i = 0; i < config.courses; ++i) {
+        std::string line;
+        double roll = chance(rng);
+        if (roll < config.malformed / 3) {
+            line = out.ids[i]; // fewer than 2 fields
+        } else if (roll < config.malformed * 2 / 3) {
+            line = "," + std::string(kWords[rng() % 12]); // empty course ID
+        } else {
+            std::string title;
+            for (size_t w = 0, n = 2 + rng() % 3; w < n; ++w) {
+                title += (w == 0 ? "" : " ") + std::string(kWords[rng() % 12]);
+            }
+            if (roll < config.malformed) {
+                title.clear(); // empty title
+            } else if (chance(rng) < config.quoted) {
+                title = (rng() % 2 == 0) ? "\"" + title + ", Part I\"" : "\"" + title + " \"\"Honors\"\"\"";
+            }
+            line = out.ids[i] + "," + title;
+            // Mostly earlier courses, like a real catalog; occasionally a later one
+            size_t prereqs = rng() % (config.fanout + 1);
+            for (size_t p = 0; p < prereqs && i > 0; ++p) {
+                size_t pick = (chance(rng) < 0.95) ? rng() % i : rng() % config.courses;
+                line += "," + out.ids[pick];
+            }
+        }
+        out.csv += line;
+        out.csv += '\n';
+        out.lines.push_back(std::move(line));
+    }
+    return out;
+}
+
+// Discards output so rendering is timed without terminal or file I/O
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Timing samples for one benchmark; each sample covers opsPerSample operations
+struct BenchResult {
+    std::string name;
+    std::vector<double> sampleNs;
+    size_t opsPerSample = 1;
+    uint64_t bytes = 0; // input bytes processed across all samples, when meaningful
+    uint64_t allocations = 0;
+};
+
+using BenchClock = std::chrono::steady_clock;
+
+static double elapsedNs(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+}
+
+// Nearest-rank percentile of sorted per-operation latencies
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static void writeResult(const BenchResult& r, bool last) {
+    std::vector<double> perOp;
+    perOp.reserve(r.sampleNs.size());
+    double totalNs = 0;
+    for (double ns : r.sampleNs) {
+        totalNs += ns;
+        perOp.push_back(ns / static_cast<double>(r.opsPerSample));
+    }
+    std::sort(perOp.begin(), perOp.end());
+    double ops = static_cast<double>(r.sampleNs.size() * r.opsPerSample);
+    double seconds = totalNs / 1e9;
+
+    std::printf("    {\"name\": \"%s\", \"ops\": %.0f, \"total_ms\": %.3f, \"ops_per_sec\": %.1f", r.name.c_str(), ops,
+                totalNs / 1e6, seconds > 0 ? ops / seconds : 0.0);
+    if (r.bytes != 0) {
+        std::printf(", \"mb_per_sec\": %.1f", seconds > 0 ? static_cast<double>(r.bytes) / 1e6 / seconds : 0.0);
+    }
+    std::printf(", \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f", percentile(perOp, 0.50),
+                percentile(perOp, 0.90), percentile(perOp, 0.99), perOp.empty() ? 0.0 : perOp.back());
+    std::printf(", \"allocs_per_op\": %.3f}%s\n", ops > 0 ? static_cast<double>(r.allocations) / ops : 0.0,
+                last ? "" : ",");
+}
+
+// parseCSVLine over every generated line. A single line takes about as long as
+// reading the clock, so samples are batches of kLinesPerSample lines.
+static BenchResult benchParseCSVLine(const GeneratedCatalog& data, size_t reps) {
+    static const size_t kLinesPerSample = 64;
+    BenchResult r;
+    r.name = "parseCSVLine";
+    r.opsPerSample = kLinesPerSample;
+    size_t sink = 0;
+    for (size_t rep = 0; rep < reps; ++rep) {
+        for (size_t i = 0; i + kLinesPerSample <= data.lines.size(); i += kLinesPerSample) {
+            uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+            BenchClock::time_point start = BenchClock::now();
+            for (size_t k = i; k < i + kLinesPerSample; ++k) {
+                sink += parseCSVLine(data.lines[k]).size();
+                r.bytes += data.lines[k].size() + 1;
+            }
+            r.sampleNs.push_back(elapsedNs(start));
+            r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+        }
+    }
+    if (sink == 0) {
+        std::fprintf(stderr, "parseCSVLine produced no fields\n");
+    }
+    return r;
+}
+
+// Whole-file loads from a temporary copy of the catalog
+static BenchResult benchLoad(const std::string& path, size_t bytes, size_t reps, const LoadOptions& options,
+                             const char* name) {
+    BenchResult r;
+    r.name = name;
+    for (size_t rep = 0; rep < reps; ++rep) {
+        Catalog catalog;
+        std::vector<std::string> warnings;
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        if (!loadCoursesFromFile(path, catalog, warnings, options)) {
+            std::exit(1);
+        }
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+        r.bytes += bytes;
+    }
+    return r;
+}
+
+static BenchResult benchSortedList(const Catalog& catalog, size_t reps) {
+    NullBuffer discard;
+    std::ostream sinkStream(&discard);
+    OutputBuffer out(sinkStream);
+    BenchResult r;
+    r.name = "printSortedCourseList";
+    for (size_t rep = 0; rep < reps; ++rep) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        printSortedCourseList(catalog, out);
+        out.flush();
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+    }
+    return r;
+}
+
+// Random lookups, one in ten for an ID that is not in the catalog
+static BenchResult benchCourseInfo(const Catalog& catalog, const GeneratedCatalog& data, size_t queries, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> ids;
+    ids.reserve(queries);
+    for (size_t i = 0; i < queries; ++i) {
+        ids.push_back(rng() % 10 == 0 ? "NOPE" + std::to_string(i) : data.ids[rng() % data.ids.size()]);
+    }
+    NullBuffer discard;
+    std::ostream sinkStream(&discard);
+    OutputBuffer out(sinkStream);
+    BenchResult r;
+    r.name = "printCourseInfo";
+    r.sampleNs.reserve(queries);
+    for (const std::string& id : ids) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        printCourseInfo(catalog, id, out);
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+    }
+    return r;
+}
+
+// Lookups drawn from kHotCourses popular IDs, like registration week traffic
+static BenchResult benchHotCourseInfo(const Catalog& catalog, const GeneratedCatalog& data, size_t queries,
+                                      uint32_t seed, CourseInfoCache* cache, const char* name) {
+    static const size_t kHotCourses = 500;
+    std::mt19937 rng(seed);
+    std::vector<std::string> ids;
+    ids.reserve(queries);
+    for (size_t i = 0; i < queries; ++i) {
+        ids.push_back(data.ids[rng() % std::min(kHotCourses, data.ids.size())]);
+    }
+    NullBuffer discard;
+    std::ostream sinkStream(&discard);
+    OutputBuffer out(sinkStream);
+    BenchResult r;
+    r.name = name;
+    r.sampleNs.reserve(queries);
+    for (const std::string& id : ids) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        printCourseInfo(catalog, id, out, cache);
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+    }
+    return r;
+}
+
+static BenchResult benchTitleIndexBuild(const Catalog& catalog, size_t reps, TitleIndex& index) {
+    BenchResult r;
+    r.name = "TitleIndex::build";
+    for (size_t rep = 0; rep < reps; ++rep) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        index.build(catalog);
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+    }
+    return r;
+}
+
+// Full integrity passes, on all cores and on one, to compare with the load
+static BenchResult benchValidate(const Catalog& catalog, size_t reps, unsigned threads, const char* name) {
+    BenchResult r;
+    r.name = name;
+    for (size_t rep = 0; rep < reps; ++rep) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        validateCatalog(catalog, threads);
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+    }
+    return r;
+}
+
+// Whole-catalog exports to a temporary file; the written size gives MB/s
+static BenchResult benchExport(const Catalog& catalog, ExportFormat format, const std::string& path, size_t reps,
+                               const char* name) {
+    BenchResult r;
+    r.name = name;
+    for (size_t rep = 0; rep < reps; ++rep) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        if (!exportCatalog(catalog, format, path)) {
+            std::exit(1);
+        }
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+        r.bytes += std::filesystem::file_size(path);
+    }
+    std::filesystem::remove(path);
+    return r;
+}
+
+// Random one- to three-word title searches, asking for a page of results the
+// way a search screen would; every search still intersects the full lists
+static const size_t kTitleSearchPage = 20;
+
+static BenchResult benchTitleSearch(const Catalog& catalog, const TitleIndex& index, size_t queries, uint32_t seed) {
+    static const char* const kWords[] = {"intro",  "data",     "structures", "systems", "theory",   "applied",
+                                         "advanced", "methods", "analysis",   "design",  "networks", "honors"};
+    std::mt19937 rng(seed);
+    std::vector<std::string> texts;
+    texts.reserve(queries);
+    for (size_t i = 0; i < queries; ++i) {
+        std::string text;
+        for (size_t w = 0, n = 1 + rng() % 3; w < n; ++w) {
+            text += (w == 0 ? "" : " ") + std::string(kWords[rng() % 12]);
+        }
+        texts.push_back(std::move(text));
+    }
+    BenchResult r;
+    r.name = "searchTitles";
+    r.sampleNs.reserve(queries);
+    size_t sink = 0;
+    for (const std::string& text : texts) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        BenchClock::time_point start = BenchClock::now();
+        sink += searchTitles(catalog, index, text, kTitleSearchPage).total;
+        r.sampleNs.push_back(elapsedNs(start));
+        r.allocations += gAllocations.load(std::memory_order_relaxed) - allocs;
+    }
+    if (sink == 0 && queries != 0) {
+        std::fprintf(stderr, "searchTitles matched nothing\n");
+    }
+    return r;
+}
+
+static void printBenchUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--courses N] [--fanout K] [--quoted R] [--malformed R]"
+              << " [--reps N] [--queries N] [--seed S]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--courses") {
+            config.courses = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--fanout") {
+            config.fanout = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--quoted") {
+            config.quoted = std::strtod(value, nullptr);
+        } else if (arg == "--malformed") {
+            config.malformed = std::strtod(value, nullptr);
+        } else if (arg == "--reps") {
+            config.reps = std::max<size_t>(1, std::strtoul(value, nullptr, 10));
+        } else if (arg == "--queries") {
+            config.queries = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--seed") {
+            config.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.courses == 0) {
+        std::cerr << "Error: --courses must be at least 1" << std::endl;
+        return 1;
+    }
+
+    GeneratedCatalog data = generateCatalog(config);
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() / ("abcu_bench_" + std::to_string(config.seed) + ".csv");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(data.csv.data(), static_cast<std::streamsize>(data.csv.size()));
+        if (!file) {
+            std::cerr << "Error: Could not write " << path.string() << std::endl;
+            return 1;
+        }
+    }
+
+    LoadOptions sequential;
+    sequential.threads = 1;
+    std::vector<BenchResult> results;
+    results.push_back(benchParseCSVLine(data, config.reps));
+    results.push_back(benchLoad(path.string(), data.csv.size(), config.reps, LoadOptions(), "loadCoursesFromFile"));
+    results.push_back(
+        benchLoad(path.string(), data.csv.size(), config.reps, sequential, "loadCoursesFromFile/1thread"));
+    LoadOptions uncompacted;
+    uncompacted.compact = false;
+    results.push_back(
+        benchLoad(path.string(), data.csv.size(), config.reps, uncompacted, "loadCoursesFromFile/nocompact"));
+
+    Catalog catalog;
+    std::vector<std::string> warnings;
+    loadCoursesFromFile(path.string(), catalog, warnings);
+    std::filesystem::remove(path);
+    results.push_back(benchSortedList(catalog, config.reps));
+    results.push_back(benchCourseInfo(catalog, data, config.queries, config.seed));
+    results.push_back(benchHotCourseInfo(catalog, data, config.queries, config.seed, nullptr, "printCourseInfo/hot"));
+    CourseInfoCache cache(1024);
+    results.push_back(
+        benchHotCourseInfo(catalog, data, config.queries, config.seed, &cache, "printCourseInfo/hot/cached"));
+    TitleIndex titles;
+    results.push_back(benchTitleIndexBuild(catalog, config.reps, titles));
+    results.push_back(benchTitleSearch(catalog, titles, std::min<size_t>(config.queries, 10000), config.seed));
+    results.push_back(benchValidate(catalog, config.reps, 0, "validateCatalog"));
+    results.push_back(benchValidate(catalog, config.reps, 1, "validateCatalog/1thread"));
+    std::string exportPath = path.string() + ".export";
+    results.push_back(benchExport(catalog, ExportFormat::Json, exportPath, config.reps, "exportCatalog/json"));
+    results.push_back(benchExport(catalog, ExportFormat::Csv, exportPath, config.reps, "exportCatalog/csv"));
+    results.push_back(benchExport(catalog, ExportFormat::Dot, exportPath, config.reps, "exportCatalog/dot"));
+
+    std::printf("{\n");
+    std::printf("  \"config\": {\"courses\": %zu, \"fanout\": %zu, \"quoted\": %.3f, \"malformed\": %.3f, "
+                "\"reps\": %zu, \"queries\": %zu, \"seed\": %u, \"bytes\": %zu, \"warnings\": %zu, "
+                "\"catalog_bytes\": %llu},\n",
+                config.courses, config.fanout, config.quoted, config.malformed, config.reps, config.queries,
+                config.seed, data.csv.size(), warnings.size(),
+                static_cast<unsigned long long>(catalog.memoryUsage().total()));
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        writeResult(results[i], i + 1 == results.size());
+    }
+    std::printf("  ]\n}\n");
+    return 0;
+}
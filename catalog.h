@@ -0,0 +1,4654 @@
+// ABCU course catalog library (header-only)
+// - Loads course data from a CSV file (CourseID, Title, Prereq1, Prereq2, ...)
+// - Memory-maps the catalog file (POSIX) and parses fields as string_view slices
+// - Scans for delimiters with SSE2/AVX2 when the compiler targets them (e.g. -mavx2)
+// - Comma, tab and pipe files parse through compile-time CsvDialect instantiations
+// - Parses large files on all cores and merges the results in file order
+// - Interns course IDs as dense integer handles; prereqs are stored as handles
+// - ID lookups use a flat open-addressing hash index (IndexBackend::Ordered selects std::map)
+// - Courses are stored as parallel arrays over one string arena and one edge array
+// - The alphanumeric course order is computed once per load, not per listing
+// - Loads end with Catalog::compact(); memoryUsage() breaks down where the bytes went
+// - Optional binary snapshots (CATALOG.csv.snap) load by mapping in place
+// - Transitive prerequisite closures, a bitset reachability index, and a semester planner
+// - Reloading applies only changed courses and keeps unaffected derived data
+// - Loaded catalogs are immutable versions published through an atomic pointer
+// - Query functions return structured results; print* renderers format them as text
+// - Prefix completion over the sorted ID order, and "did you mean" for unknown IDs
+// - Title word search over a block-compressed inverted index (TitleIndex)
+// - CatalogFederation loads several catalogs in parallel as named shards ("SHARD:ID")
+// - validateCatalog checks for undefined prereqs, duplicate lines, self-prereqs and cycles
+// - CourseInfoCache keeps rendered course output, dropped automatically on reload
+// - exportCatalog writes JSON, CSV or DOT, formatting chunks in parallel and writing with writev
+// - streamCourseRecords parses any size of input in bounded memory through callbacks
+// - gzip/zstd catalogs (opt-in builds) decompress on a second thread, pipelined with the parse
+// - -DABCU_ENABLE_METRICS adds phase timers and counters to loads and queries
+//
+// Include it from any number of translation units; final.cpp is the menu front end.
+
+#ifndef ABCU_CATALOG_H
+#define ABCU_CATALOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__AVX2__))
+#define ABCU_HAVE_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ABCU_HAVE_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Optional compressed input. Build with -DABCU_ENABLE_ZLIB (and link -lz) to
+// read gzip catalogs, -DABCU_ENABLE_ZSTD (-lzstd) for zstd; they are opt-in
+// because the header alone cannot add the link flag.
+#ifdef ABCU_ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ABCU_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+// Optional instrumentation. Build with -DABCU_ENABLE_METRICS and loads and
+// queries record phase timings and counters (LoadMetrics, gQueryMetrics);
+// without it these macros expand to nothing and the hooks cost nothing.
+#ifdef ABCU_ENABLE_METRICS
+#define ABCU_METRICS_CONCAT2(a, b) a##b
+#define ABCU_METRICS_CONCAT(a, b) ABCU_METRICS_CONCAT2(a, b)
+// Add the nanoseconds until the end of the enclosing scope to counter
+#define ABCU_SCOPED_TIMER(counter) \
+    ScopedTimer<decltype(counter)> ABCU_METRICS_CONCAT(abcuScopedTimer, __LINE__)(counter)
+// Add n to counter
+#define ABCU_COUNT(counter, n) ((counter) += (n))
+#else
+#define ABCU_SCOPED_TIMER(counter) ((void)0)
+#define ABCU_COUNT(counter, n) ((void)0)
+#endif
+
+// Adds its lifetime in nanoseconds to a counter (plain or std::atomic)
+template <typename Counter>
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Counter& counter) : counter_(counter), start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        counter_ += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Counter& counter_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Where one load spent its time. The split / normalize / insert phases are
+// CPU time summed over parser threads; totalNs is wall time. Streamed input
+// (pipes) is read, split, normalized and inserted in one pass, all of which
+// is reported as splitNs.
+struct LoadMetrics {
+    uint64_t bytes = 0;        // input size; 0 for streamed input
+    uint64_t records = 0;      // lines that defined or extended a course
+    uint64_t placeholders = 0; // courses referenced as prereqs but never defined
+    uint64_t warnings = 0;
+    uint64_t openNs = 0;      // opening and mapping the file
+    uint64_t snapshotNs = 0;  // checking, loading or writing the snapshot
+    uint64_t splitNs = 0;     // CSV field splitting
+    uint64_t normalizeNs = 0; // record validation and ID normalization
+    uint64_t insertNs = 0;    // interning IDs, recording titles and edges
+    uint64_t mergeNs = 0;     // folding parallel chunks together, resolving placeholders across them
+    uint64_t finalizeNs = 0;  // grouping edges and sorting the course order
+    uint64_t compactNs = 0;   // Catalog::compact() after the parse
+    uint64_t warningNs = 0;   // formatting the warning list
+    uint64_t decompressNs = 0; // compressed input: decompressing, on its own thread alongside the parse
+    uint64_t decompressedBytes = 0;
+    uint64_t totalNs = 0;
+    bool fromSnapshot = false;
+
+    // Sum the per-thread parse counters
+    LoadMetrics& operator+=(const LoadMetrics& other) {
+        records += other.records;
+        splitNs += other.splitNs;
+        normalizeNs += other.normalizeNs;
+        insertNs += other.insertNs;
+        return *this;
+    }
+
+    // Fold in a whole load run alongside this one (a federation shard): every
+    // counter and phase adds up, totalNs stays the caller's wall time, and the
+    // result counts as from a snapshot only if every part was
+    void addShard(const LoadMetrics& other, bool first) {
+        *this += other;
+        bytes += other.bytes;
+        placeholders += other.placeholders;
+        warnings += other.warnings;
+        openNs += other.openNs;
+        snapshotNs += other.snapshotNs;
+        mergeNs += other.mergeNs;
+        finalizeNs += other.finalizeNs;
+        compactNs += other.compactNs;
+        warningNs += other.warningNs;
+        decompressNs += other.decompressNs;
+        decompressedBytes += other.decompressedBytes;
+        fromSnapshot = (first || fromSnapshot) && other.fromSnapshot;
+    }
+};
+
+// Calls and time per query kind, shared by every thread
+struct QueryMetrics {
+    std::atomic<uint64_t> courseLookups{0};
+    std::atomic<uint64_t> courseLookupNs{0};
+    std::atomic<uint64_t> chainLookups{0};
+    std::atomic<uint64_t> chainLookupNs{0};
+    std::atomic<uint64_t> requirementChecks{0};
+    std::atomic<uint64_t> requirementCheckNs{0};
+    std::atomic<uint64_t> titleSearches{0};
+    std::atomic<uint64_t> titleSearchNs{0};
+};
+
+inline QueryMetrics gQueryMetrics;
+
+// Read-only memory mapping of a whole regular file. valid() is false when the
+// file cannot be mapped (missing, not a regular file, or no mmap support), in
+// which case callers fall back to stream reading.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+#ifdef ABCU_HAVE_POSIX
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0) {
+                valid_ = true; // mmap rejects empty files; an empty view is fine
+            } else {
+                void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    data_ = static_cast<const char*>(p);
+                    valid_ = true;
+#ifdef MADV_SEQUENTIAL
+                    ::madvise(p, size_, MADV_SEQUENTIAL);
+#endif
+                }
+            }
+        }
+        ::close(fd);
+#else
+        (void)filename;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef ABCU_HAVE_POSIX
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const { return valid_; }
+    std::string_view view() const { return std::string_view(data_, data_ != nullptr ? size_ : 0); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool valid_ = false;
+};
+
+// Handle value meaning "no such course"
+static const uint32_t kNoCourse = UINT32_MAX;
+
+// Location of a string inside a StringArena
+struct TextRef {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// Bump allocator for course IDs and titles: every string is appended to one
+// contiguous buffer and addressed by offset, so releasing all of them is a
+// single free. Offsets are 32-bit, which caps a catalog at 4 GiB of text.
+class StringArena {
+public:
+    TextRef append(std::string_view s) {
+        TextRef ref{static_cast<uint32_t>(buffer_.size()), static_cast<uint32_t>(s.size())};
+        buffer_.append(s.data(), s.size());
+        return ref;
+    }
+
+    std::string_view view(TextRef ref) const { return std::string_view(buffer_.data() + ref.offset, ref.length); }
+    const char* data() const { return buffer_.data(); }
+    size_t size() const { return buffer_.size(); }
+    size_t capacity() const { return buffer_.capacity(); }
+    void reserve(size_t bytes) { buffer_.reserve(bytes); }
+
+    // Drop all strings and give the buffer back
+    void release() { std::string().swap(buffer_); }
+
+private:
+    std::string buffer_;
+};
+
+// Read access to interned IDs by handle, handed to a CourseIndex on each call
+// because arena growth may move the underlying bytes.
+struct IdKeys {
+    const char* text;
+    const TextRef* refs;
+
+    std::string_view operator[](uint32_t handle) const {
+        return std::string_view(text + refs[handle].offset, refs[handle].length);
+    }
+};
+
+// Mapping from normalized course ID to handle
+class CourseIndex {
+public:
+    virtual ~CourseIndex() = default;
+
+    // Handle stored for id, or kNoCourse
+    virtual uint32_t find(std::string_view id, const IdKeys& keys) const = 0;
+
+    // Add keys[handle], which must not already be present
+    virtual void insert(uint32_t handle, const IdKeys& keys) = 0;
+
+    // Prepare for about count keys before bulk inserts; purely an optimization
+    virtual void reserve(size_t) {}
+
+    virtual void clear() = 0;
+
+    // Heap bytes held, keys included when the index owns them
+    virtual size_t memoryBytes() const = 0;
+};
+
+// Ordered red-black tree backend (the original std::map behavior, owning its keys)
+class OrderedCourseIndex : public CourseIndex {
+public:
+    uint32_t find(std::string_view id, const IdKeys&) const override {
+        auto it = map_.find(id);
+        return it == map_.end() ? kNoCourse : it->second;
+    }
+
+    void insert(uint32_t handle, const IdKeys& keys) override { map_.emplace(std::string(keys[handle]), handle); }
+    void clear() override { map_.clear(); }
+
+    // An estimate: the node layout is the library's, taken here as three
+    // pointers and a color word ahead of the value
+    size_t memoryBytes() const override {
+        size_t bytes = map_.size() * (4 * sizeof(void*) + sizeof(std::pair<const std::string, uint32_t>));
+        for (const auto& entry : map_) {
+            if (entry.first.capacity() > std::string().capacity()) { // past the small-string buffer
+                bytes += entry.first.capacity() + 1;
+            }
+        }
+        return bytes;
+    }
+
+private:
+    std::map<std::string, uint32_t, std::less<>> map_;
+};
+
+// Open-addressing hash backend in the SwissTable style: one control byte per
+// slot (kEmpty, or 7 bits of the key's hash) scanned 16 at a time, and a
+// contiguous array of 4-byte handle slots whose keys are read from the arena.
+// Probing visits whole 16-slot groups, so a lookup usually touches one control
+// group and compares one key. There are no deletions, so no tombstones are needed.
+class FlatCourseIndex : public CourseIndex {
+public:
+    uint32_t find(std::string_view id, const IdKeys& keys) const override {
+        if (slots_.empty()) {
+            return kNoCourse;
+        }
+        uint64_t hash = hashId(id);
+        size_t groupMask = slots_.size() / kGroupSize - 1;
+        size_t group = static_cast<size_t>(hash >> 7) & groupMask;
+        for (size_t step = 1;; ++step) {
+            const int8_t* ctrl = &ctrl_[group * kGroupSize];
+            for (unsigned mask = matchByte(ctrl, controlByte(hash)); mask != 0; mask &= mask - 1) {
+                uint32_t handle = slots_[group * kGroupSize + lowestBit(mask)];
+                if (keys[handle] == id) {
+                    return handle;
+                }
+            }
+            if (matchByte(ctrl, kEmpty) != 0) {
+                return kNoCourse;
+            }
+            group = (group + step) & groupMask; // triangular probing visits every group
+        }
+    }
+
+    void insert(uint32_t handle, const IdKeys& keys) override {
+        if ((size_ + 1) * 8 > slots_.size() * 7) { // keep load factor <= 7/8
+            rehash(slots_.empty() ? kGroupSize : slots_.size() * 2, keys);
+        }
+        place(handle, hashId(keys[handle]));
+        ++size_;
+    }
+
+    // Presize an empty table so bulk inserts never rehash
+    void reserve(size_t count) override {
+        size_t capacity = kGroupSize;
+        while (capacity * 7 < count * 8) {
+            capacity *= 2;
+        }
+        if (size_ == 0 && capacity > slots_.size()) {
+            ctrl_.assign(capacity, kEmpty);
+            slots_.assign(capacity, 0);
+        }
+    }
+
+    void clear() override {
+        std::vector<int8_t>().swap(ctrl_);
+        std::vector<uint32_t>().swap(slots_);
+        size_ = 0;
+    }
+
+    size_t memoryBytes() const override { return ctrl_.capacity() + slots_.capacity() * sizeof(uint32_t); }
+
+private:
+    static constexpr size_t kGroupSize = 16;
+    static constexpr int8_t kEmpty = -128;
+
+    // FNV-1a with a final avalanche so both the group bits and the control bits are well mixed
+    static uint64_t hashId(std::string_view id) {
+        uint64_t h = 14695981039346656037ull;
+        for (char c : id) {
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static int8_t controlByte(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+
+    static unsigned lowestBit(unsigned mask) {
+#ifdef __GNUC__
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+        unsigned bit = 0;
+        while ((mask & 1u) == 0) {
+            mask >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // Bit i set when ctrl[i] == value, for the 16 bytes of one group
+    static unsigned matchByte(const int8_t* ctrl, int8_t value) {
+#ifdef ABCU_HAVE_SIMD
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value))));
+#else
+        unsigned mask = 0;
+        for (size_t i = 0; i < kGroupSize; ++i) {
+            if (ctrl[i] == value) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    void place(uint32_t handle, uint64_t hash) {
+        size_t groupMask = slots_.size() / kGroupSize - 1;
+        size_t group = static_cast<size_t>(hash >> 7) & groupMask;
+        for (size_t step = 1;; ++step) {
+            unsigned empty = matchByte(&ctrl_[group * kGroupSize], kEmpty);
+            if (empty != 0) {
+                size_t i = group * kGroupSize + lowestBit(empty);
+                ctrl_[i] = controlByte(hash);
+                slots_[i] = handle;
+                return;
+            }
+            group = (group + step) & groupMask;
+        }
+    }
+
+    void rehash(size_t capacity, const IdKeys& keys) {
+        std::vector<int8_t> oldCtrl(capacity, kEmpty);
+        std::vector<uint32_t> oldSlots(capacity);
+        oldCtrl.swap(ctrl_);
+        oldSlots.swap(slots_);
+        for (size_t i = 0; i < oldSlots.size(); ++i) {
+            if (oldCtrl[i] != kEmpty) {
+                place(oldSlots[i], hashId(keys[oldSlots[i]]));
+            }
+        }
+    }
+
+    std::vector<int8_t> ctrl_;
+    std::vector<uint32_t> slots_; // course handles
+    size_t size_ = 0;
+};
+
+// Which CourseIndex implementation a catalog uses
+enum class IndexBackend { Ordered, FlatHash };
+
+inline std::unique_ptr<CourseIndex> makeCourseIndex(IndexBackend backend) {
+    if (backend == IndexBackend::Ordered) {
+        return std::make_unique<OrderedCourseIndex>();
+    }
+    return std::make_unique<FlatCourseIndex>();
+}
+
+// Contiguous run of course handles (a course's prerequisites)
+struct HandleRange {
+    const uint32_t* first = nullptr;
+    const uint32_t* last = nullptr;
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// Read-only view of one course; the strings point into the catalog's arena
+struct Course {
+    std::string_view id;
+    std::string_view title; // empty for placeholders (referenced but never defined)
+    HandleRange prereqs;    // prerequisite course handles, in file order
+};
+
+// One "course requires prereq" edge recorded during loading
+struct PrereqEdge {
+    uint32_t course;
+    uint32_t prereq;
+};
+
+// A course line for an ID that an earlier line already defined
+struct DuplicateDefinition {
+    uint32_t course;
+    uint32_t line;
+};
+
+// Column pointers of a catalog. They point into the catalog's own buffers,
+// or straight into a mapped snapshot file (see openCatalogSnapshot).
+struct CatalogArrays {
+    const char* text = nullptr;
+    uint64_t textBytes = 0;
+    const TextRef* ids = nullptr;    // per course: interned ID
+    const TextRef* titles = nullptr; // per course: current title
+    uint32_t courseCount = 0;
+    const uint32_t* prereqOffsets = nullptr; // per course + 1: start of its run in prereqs; null until finalized
+    const uint32_t* prereqs = nullptr;       // all prerequisite handles, grouped by course
+    uint32_t edgeCount = 0;
+    const uint32_t* sorted = nullptr; // sortedOrder()
+    uint32_t sortedCount = 0;
+    const uint32_t* defLines = nullptr; // per course: line that first defined it, 0 if never defined
+    const DuplicateDefinition* duplicates = nullptr; // later definitions, in load order
+    uint32_t duplicateCount = 0;
+};
+
+// Heap bytes a vector has allocated
+template <typename T>
+uint64_t vectorBytes(const std::vector<T>& v) {
+    return uint64_t(v.capacity()) * sizeof(T);
+}
+
+// Bytes held by one catalog, by what they hold. Columns are counted where
+// they live: on the heap, or in the mapping of an attached snapshot.
+struct CatalogMemory {
+    uint64_t idBytes = 0;         // ID text and its per-course references
+    uint64_t titleBytes = 0;      // current titles and their references
+    uint64_t deadTextBytes = 0;   // arena bytes of titles that later lines replaced
+    uint64_t edgeBytes = 0;       // prereq edges, their per-course offsets, and edges not yet grouped
+    uint64_t orderBytes = 0;      // sortedOrder()
+    uint64_t definitionBytes = 0; // definition lines and duplicates
+    uint64_t indexBytes = 0;      // the ID index
+    uint64_t slackBytes = 0;      // capacity reserved past the end of the owned buffers
+    uint64_t placeholders = 0;    // courses never defined; included in the rows above
+    uint64_t placeholderBytes = 0; // their IDs, references and definition lines
+    bool mapped = false;          // the columns live in a snapshot mapping
+
+    uint64_t total() const {
+        return idBytes + titleBytes + deadTextBytes + edgeBytes + orderBytes + definitionBytes + indexBytes +
+               slackBytes;
+    }
+};
+
+// All loaded courses as a structure of arrays indexed by course handle.
+// Normalized IDs (the output of toUpper(trim(...))) are interned as dense
+// handles 0..size()-1 in order of first appearance; every interned ID has a
+// course, and placeholders keep an empty title until defined. IDs and titles
+// live in one StringArena, and prerequisites in one flat edge array.
+//
+// Loading appends edges in file order; finalize() then groups them per course
+// (a stable counting sort) so prereqs() is a plain array slice, and builds
+// sortedOrder(), the defined courses in alphanumeric ID order. The line that
+// first defined each course, and every later one, is kept for validation.
+//
+// All reads go through arrays(), so a catalog can also serve a mapped
+// snapshot in place (attach()); such a catalog is read-only until clear().
+// compact() gives back what loading over-allocated once a version is done.
+class Catalog {
+public:
+    explicit Catalog(IndexBackend backend = IndexBackend::FlatHash) : backend_(backend), index_(makeCourseIndex(backend)) {}
+
+    IndexBackend backend() const { return backend_; }
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    uint32_t find(std::string_view id) const { return index_->find(id, keys()); }
+
+    // Handle for id, adding a placeholder course the first time it is seen
+    uint32_t intern(std::string_view id) {
+        uint32_t handle = index_->find(id, keys());
+        if (handle != kNoCourse) {
+            return handle;
+        }
+        handle = static_cast<uint32_t>(ids_.size());
+        ids_.push_back(text_.append(id));
+        titles_.emplace_back();
+        defLines_.push_back(0);
+        syncArrays();
+        index_->insert(handle, keys());
+        return handle;
+    }
+
+    // Replace the title; the old bytes stay in the arena until the next clear()
+    void setTitle(uint32_t handle, std::string_view title) {
+        titles_[handle] = text_.append(title);
+        syncArrays();
+    }
+
+    // Record that line defines handle; every definition after the first is
+    // kept as a duplicate (line numbers start at 1)
+    void define(uint32_t handle, uint32_t line) {
+        if (defLines_[handle] == 0) {
+            defLines_[handle] = line;
+        } else {
+            duplicates_.push_back({handle, line});
+            syncArrays();
+        }
+    }
+
+    // Record that course requires prereq; visible through prereqs() after finalize()
+    void addPrereq(uint32_t course, uint32_t prereq) { pendingPrereqs_.push_back({course, prereq}); }
+
+    const std::vector<PrereqEdge>& pendingPrereqs() const { return pendingPrereqs_; }
+
+    // Group the recorded edges by course, keeping file order within each course.
+    // sortOrder=false skips building sortedOrder() for callers that derive it
+    // from a previous version with setSortedOrder().
+    void finalize(bool sortOrder = true) {
+        const size_t n = ids_.size();
+        std::vector<uint32_t> offsets(n + 1, 0);
+        for (const PrereqEdge& e : pendingPrereqs_) {
+            ++offsets[e.course + 1];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        std::vector<uint32_t> edges(pendingPrereqs_.size());
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (const PrereqEdge& e : pendingPrereqs_) {
+            edges[next[e.course]++] = e.prereq;
+        }
+        prereqOffsets_.swap(offsets);
+        prereqs_.swap(edges);
+        std::vector<PrereqEdge>().swap(pendingPrereqs_);
+
+        sorted_.clear();
+        if (sortOrder) {
+            sorted_.reserve(n);
+            for (uint32_t h = 0; h < n; ++h) {
+                if (titles_[h].length != 0) { // placeholders are never listed
+                    sorted_.push_back(h);
+                }
+            }
+        }
+        syncArrays();
+        std::sort(sorted_.begin(), sorted_.end(), [this](uint32_t a, uint32_t b) { return id(a) < id(b); });
+        version_ = nextVersion();
+    }
+
+    // Install a sorted order computed elsewhere (all defined courses, by ID)
+    void setSortedOrder(std::vector<uint32_t> order) {
+        sorted_.swap(order);
+        syncArrays();
+        version_ = nextVersion();
+    }
+
+    // Serve columns that live outside the catalog, e.g. in a mapped snapshot.
+    // backing keeps that memory alive; the ID index is rebuilt over the new keys.
+    void attach(std::unique_ptr<MappedFile> backing, const CatalogArrays& arrays) {
+        clear();
+        backing_ = std::move(backing);
+        arrays_ = arrays;
+        index_->reserve(arrays_.courseCount);
+        for (uint32_t h = 0; h < arrays_.courseCount; ++h) {
+            index_->insert(h, keys());
+        }
+        version_ = nextVersion();
+    }
+
+    const CatalogArrays& arrays() const { return arrays_; }
+
+    // Handles of all defined (non-placeholder) courses, sorted by ID; built by finalize()
+    HandleRange sortedOrder() const { return HandleRange{arrays_.sorted, arrays_.sorted + arrays_.sortedCount}; }
+
+    std::string_view id(uint32_t handle) const {
+        return std::string_view(arrays_.text + arrays_.ids[handle].offset, arrays_.ids[handle].length);
+    }
+
+    std::string_view title(uint32_t handle) const {
+        return std::string_view(arrays_.text + arrays_.titles[handle].offset, arrays_.titles[handle].length);
+    }
+
+    HandleRange prereqs(uint32_t handle) const {
+        if (arrays_.prereqOffsets == nullptr) {
+            return HandleRange(); // not finalized yet
+        }
+        const uint32_t* base = arrays_.prereqs;
+        return HandleRange{base + arrays_.prereqOffsets[handle], base + arrays_.prereqOffsets[handle + 1]};
+    }
+
+    // Line that first defined handle, or 0 for a course that is only referenced
+    uint32_t definitionLine(uint32_t handle) const { return arrays_.defLines[handle]; }
+
+    const DuplicateDefinition* duplicatesBegin() const { return arrays_.duplicates; }
+    const DuplicateDefinition* duplicatesEnd() const { return arrays_.duplicates + arrays_.duplicateCount; }
+
+    Course course(uint32_t handle) const { return Course{id(handle), title(handle), prereqs(handle)}; }
+    size_t size() const { return arrays_.courseCount; }
+
+    // Changes with every finalize(), setSortedOrder() and attach() and is never
+    // reused in the process, so caches of derived output can tell versions apart
+    uint64_t version() const { return version_; }
+
+    // Where the catalog's bytes go; see CatalogMemory
+    CatalogMemory memoryUsage() const {
+        CatalogMemory m;
+        const CatalogArrays& a = arrays_;
+        for (uint32_t h = 0; h < a.courseCount; ++h) {
+            m.idBytes += a.ids[h].length;
+            m.titleBytes += a.titles[h].length;
+            if (a.defLines[h] == 0) {
+                ++m.placeholders;
+                m.placeholderBytes += a.ids[h].length + 2 * sizeof(TextRef) + sizeof(uint32_t);
+            }
+        }
+        m.deadTextBytes = a.textBytes - m.idBytes - m.titleBytes;
+        m.idBytes += uint64_t(a.courseCount) * sizeof(TextRef);
+        m.titleBytes += uint64_t(a.courseCount) * sizeof(TextRef);
+        m.edgeBytes = (a.prereqOffsets != nullptr ? (uint64_t(a.courseCount) + 1) * sizeof(uint32_t) : 0) +
+                      uint64_t(a.edgeCount) * sizeof(uint32_t) + pendingPrereqs_.size() * sizeof(PrereqEdge);
+        m.orderBytes = uint64_t(a.sortedCount) * sizeof(uint32_t);
+        m.definitionBytes =
+            uint64_t(a.courseCount) * sizeof(uint32_t) + uint64_t(a.duplicateCount) * sizeof(DuplicateDefinition);
+        m.indexBytes = index_->memoryBytes();
+        uint64_t arenaSlack = text_.size() != 0 ? text_.capacity() - text_.size() : 0; // empty: no heap block
+        m.slackBytes = arenaSlack + slackBytes(ids_) + slackBytes(titles_) +
+                       slackBytes(prereqOffsets_) + slackBytes(prereqs_) + slackBytes(pendingPrereqs_) +
+                       slackBytes(sorted_) + slackBytes(defLines_) + slackBytes(duplicates_);
+        m.mapped = backing_ != nullptr;
+        return m;
+    }
+
+    // Give back what loading left behind: rewrite the arena with only the
+    // live strings (every ID first, so index probes read neighbouring bytes)
+    // and trim each column to its size. Handles, contents and version() stay
+    // the same, so caches keyed on them remain valid; call it before other
+    // threads read the catalog. Placeholders keep their rows because handles
+    // must not move (reloadCoursesFromFile renumbers once orphans pile up).
+    // An attached snapshot is already exact and is left alone.
+    void compact() {
+        if (backing_ != nullptr) {
+            return;
+        }
+        const size_t n = ids_.size();
+        StringArena packed;
+        size_t live = 0;
+        for (size_t h = 0; h < n; ++h) {
+            live += ids_[h].length + titles_[h].length;
+        }
+        packed.reserve(live);
+        for (size_t h = 0; h < n; ++h) {
+            ids_[h] = packed.append(id(static_cast<uint32_t>(h)));
+        }
+        for (size_t h = 0; h < n; ++h) {
+            titles_[h] = packed.append(title(static_cast<uint32_t>(h)));
+        }
+        text_ = std::move(packed);
+        ids_.shrink_to_fit();
+        titles_.shrink_to_fit();
+        prereqOffsets_.shrink_to_fit();
+        prereqs_.shrink_to_fit();
+        pendingPrereqs_.shrink_to_fit();
+        sorted_.shrink_to_fit();
+        defLines_.shrink_to_fit();
+        duplicates_.shrink_to_fit();
+        syncArrays();
+    }
+
+    // Release everything: a handful of frees instead of one per string
+    void clear() {
+        index_->clear();
+        text_.release();
+        std::vector<TextRef>().swap(ids_);
+        std::vector<TextRef>().swap(titles_);
+        std::vector<uint32_t>().swap(prereqOffsets_);
+        std::vector<uint32_t>().swap(prereqs_);
+        std::vector<PrereqEdge>().swap(pendingPrereqs_);
+        std::vector<uint32_t>().swap(sorted_);
+        std::vector<uint32_t>().swap(defLines_);
+        std::vector<DuplicateDefinition>().swap(duplicates_);
+        backing_.reset();
+        syncArrays();
+    }
+
+private:
+    IdKeys keys() const { return IdKeys{arrays_.text, arrays_.ids}; }
+
+    template <typename T>
+    static uint64_t slackBytes(const std::vector<T>& v) {
+        return (v.capacity() - v.size()) * sizeof(T);
+    }
+
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // Point arrays_ at the owned buffers again after they grew or were replaced
+    void syncArrays() {
+        arrays_.text = text_.data();
+        arrays_.textBytes = text_.size();
+        arrays_.ids = ids_.data();
+        arrays_.titles = titles_.data();
+        arrays_.courseCount = static_cast<uint32_t>(ids_.size());
+        arrays_.prereqOffsets = prereqOffsets_.empty() ? nullptr : prereqOffsets_.data();
+        arrays_.prereqs = prereqs_.data();
+        arrays_.edgeCount = static_cast<uint32_t>(prereqs_.size());
+        arrays_.sorted = sorted_.data();
+        arrays_.sortedCount = static_cast<uint32_t>(sorted_.size());
+        arrays_.defLines = defLines_.data();
+        arrays_.duplicates = duplicates_.data();
+        arrays_.duplicateCount = static_cast<uint32_t>(duplicates_.size());
+    }
+
+    StringArena text_;
+    std::vector<TextRef> ids_;
+    std::vector<TextRef> titles_;
+    std::vector<uint32_t> prereqOffsets_;
+    std::vector<uint32_t> prereqs_;
+    std::vector<PrereqEdge> pendingPrereqs_;
+    std::vector<uint32_t> sorted_;
+    std::vector<uint32_t> defLines_;
+    std::vector<DuplicateDefinition> duplicates_;
+    std::unique_ptr<MappedFile> backing_; // set when attached to a snapshot
+    CatalogArrays arrays_;
+    IndexBackend backend_;
+    std::unique_ptr<CourseIndex> index_;
+    uint64_t version_ = 0;
+};
+
+// Trim leading and trailing whitespace without copying
+inline std::string_view trimView(std::string_view s) {
+    size_t start = 0;
+    while (start < s.size() && std::isspace(static_cast<unsigned char>(s[start]))) {
+        start++;
+    }
+    size_t end = s.size();
+    while (end > start && std::isspace(static_cast<unsigned char>(s[end - 1]))) {
+        end--;
+    }
+    return s.substr(start, end - start);
+}
+
+// Trim leading and trailing whitespace
+inline std::string trim(const std::string& s) {
+    return std::string(trimView(s));
+}
+
+// Uppercase ASCII letters in place, 16 bytes at a time where SSE2 is on.
+// Same result as std::toupper in the "C" locale, without its per-call cost.
+inline void upperInPlace(char* p, size_t n) {
+#ifdef ABCU_HAVE_SIMD
+    const __m128i belowA = _mm_set1_epi8('a' - 1);
+    const __m128i aboveZ = _mm_set1_epi8('z' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; n >= 16; p += 16, n -= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // Bytes >= 0x80 compare as negative, so they never count as lowercase
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chunk, belowA), _mm_cmplt_epi8(chunk, aboveZ));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_sub_epi8(chunk, _mm_and_si128(lower, caseBit)));
+    }
+#endif
+    for (; n > 0; ++p, --n) {
+        if (*p >= 'a' && *p <= 'z') {
+            *p = static_cast<char>(*p - ('a' - 'A'));
+        }
+    }
+}
+
+// Append s to out in uppercase (ASCII). Reuses out's capacity, so a buffer
+// kept across calls stops allocating once it has grown.
+inline void appendUpper(std::string& out, std::string_view s) {
+    size_t offset = out.size();
+    out.append(s.data(), s.size());
+    upperInPlace(&out[0] + offset, s.size());
+}
+
+// Uppercase a string (ASCII)
+inline std::string toUpper(std::string_view s) {
+    std::string t;
+    appendUpper(t, s);
+    return t;
+}
+
+// Decode one quoted CSV field: quotes open/close quoting and a doubled quote
+// inside quotes yields a literal quote. Appends the decoded bytes to out.
+inline void decodeQuotedField(std::string_view raw, std::string& out, char quote = '"') {
+    bool inQuotes = false;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char ch = raw[i];
+        if (inQuotes) {
+            if (ch == quote) {
+                // If this is a doubled quote, append one and continue inside quotes
+                if (i + 1 < raw.size() && raw[i + 1] == quote) {
+                    out.push_back(quote);
+                    ++i;
+                } else {
+                    inQuotes = false;
+                }
+            } else {
+                out.push_back(ch);
+            }
+        } else if (ch == quote) {
+            inQuotes = true;
+        } else {
+            out.push_back(ch);
+        }
+    }
+}
+
+// Return the first position in [p, end) holding a or b, or end if neither occurs.
+// Reference implementation; the vector path below must agree with it exactly
+// (scan_test.cpp checks both on the same lines).
+inline const char* findEitherScalar(const char* p, const char* end, char a, char b) {
+    while (p != end && *p != a && *p != b) {
+        ++p;
+    }
+    return p;
+}
+
+// Same contract as findEitherScalar, comparing 32 (AVX2) or 16 (SSE2) bytes per
+// step and finishing the tail with the scalar loop.
+inline const char* findEither(const char* p, const char* end, char a, char b) {
+#ifdef ABCU_HAVE_SIMD
+#ifdef __AVX2__
+    const __m256i wideA = _mm256_set1_epi8(a);
+    const __m256i wideB = _mm256_set1_epi8(b);
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, wideA), _mm256_cmpeq_epi8(chunk, wideB));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#endif
+    const __m128i vecA = _mm_set1_epi8(a);
+    const __m128i vecB = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, vecA), _mm_cmpeq_epi8(chunk, vecB));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    return findEitherScalar(p, end, a, b);
+}
+
+// Scanner signature shared by the scalar and vector paths
+using ScanFn = const char* (*)(const char*, const char*, char, char);
+
+// Field syntax of a catalog file, fixed at compile time so each combination
+// gets its own splitting and normalizing loop with the unused branches gone.
+// Quote = '\0' turns quoting off; Trim strips whitespace around every field;
+// UpperIds uppercases IDs and prereqs (turn it off only for exports that
+// already write them in upper case, since lookups always uppercase queries).
+template <char Delimiter, char Quote, bool Trim, bool UpperIds>
+struct CsvDialect {
+    static constexpr char delimiter = Delimiter;
+    static constexpr char quote = Quote;
+    static constexpr bool trim = Trim;
+    static constexpr bool upperIds = UpperIds;
+};
+
+using CommaDialect = CsvDialect<',', '"', true, true>; // the ABCU catalog format
+using TabDialect = CsvDialect<'\t', '\0', true, true>;
+using PipeDialect = CsvDialect<'|', '\0', true, true>;
+
+// Split one line into fields without copying. Fields without quotes are
+// slices of line; quoted fields are decoded into scratch, which is reserved
+// to the line length first so earlier slices into it stay valid.
+// scan selects the delimiter scanner (vector by default, scalar for cross-checks).
+template <typename Dialect>
+void splitFields(std::string_view line, std::vector<std::string_view>& fields, std::string& scratch,
+                 ScanFn scan = findEither) {
+    fields.clear();
+    const char* begin = line.data();
+    const char* end = begin + line.size();
+    const char* fieldStart = begin;
+    const char* p = begin;
+    auto finish = [](std::string_view raw) {
+        if constexpr (Dialect::trim) {
+            return trimView(raw);
+        } else {
+            return raw;
+        }
+    };
+
+    if constexpr (Dialect::quote == '\0') {
+        (void)scratch;
+        while (true) {
+            p = scan(p, end, Dialect::delimiter, Dialect::delimiter);
+            fields.push_back(finish(std::string_view(fieldStart, static_cast<size_t>(p - fieldStart))));
+            if (p == end) {
+                break;
+            }
+            fieldStart = ++p;
+        }
+    } else {
+        scratch.clear();
+        scratch.reserve(line.size());
+        bool hasQuote = false;
+        while (true) {
+            p = scan(p, end, Dialect::delimiter, Dialect::quote);
+            if (p != end && *p == Dialect::quote) {
+                // Skip to the closing quote. A doubled quote closes and immediately
+                // reopens, so this finds the same boundaries as the full escape rules
+                // in decodeQuotedField.
+                hasQuote = true;
+                p = scan(p + 1, end, Dialect::quote, Dialect::quote);
+                if (p != end) {
+                    ++p;
+                }
+                continue;
+            }
+
+            std::string_view raw(fieldStart, static_cast<size_t>(p - fieldStart));
+            if (hasQuote) {
+                size_t offset = scratch.size();
+                decodeQuotedField(raw, scratch, Dialect::quote);
+                raw = std::string_view(scratch).substr(offset);
+            }
+            fields.push_back(finish(raw));
+            if (p == end) {
+                break;
+            }
+            fieldStart = ++p;
+            hasQuote = false;
+        }
+    }
+}
+
+// Split a CSV line (CommaDialect) into trimmed fields; see splitFields
+inline void splitCSVLine(std::string_view line, std::vector<std::string_view>& fields, std::string& scratch,
+                         ScanFn scan = findEither) {
+    splitFields<CommaDialect>(line, fields, scratch, scan);
+}
+
+// Basic CSV line parser supporting quotes around fields with commas
+inline std::vector<std::string> parseCSVLine(const std::string& line) {
+    std::vector<std::string_view> views;
+    std::string scratch;
+    splitCSVLine(line, views, scratch);
+    return std::vector<std::string>(views.begin(), views.end());
+}
+
+// A load warning tied to its source line; formatted as "Line N ..." once line
+// numbers are final (parallel chunks only know their local line numbers).
+struct LineWarning {
+    size_t line;
+    std::string message;
+};
+
+// One validated CSV record. Parsers reuse a single record from line to line,
+// so callbacks must copy anything they keep.
+struct CourseRecord {
+    size_t line = 0;
+    std::string_view id;                   // normalized
+    std::string_view title;                // original case; may be empty
+    std::vector<std::string_view> prereqs; // normalized, empty fields dropped
+    std::string normalized;                // holds id and prereqs; capacity is kept between records
+};
+
+// Validate one CSV line (already split into fields) into record. Problems are
+// reported as warn(line, message); returns false when the line is skipped.
+template <typename Dialect = CommaDialect, typename OnWarning>
+bool readCourseRecord(size_t lineNum, const std::vector<std::string_view>& fields, CourseRecord& record,
+                      OnWarning&& warn) {
+    if (fields.size() < 2) {
+        warn(lineNum, "skipped: fewer than 2 fields");
+        return false;
+    }
+
+    // One uppercasing pass per field, into a buffer sized up front so the
+    // views handed out below stay valid while it fills
+    size_t total = 0;
+    for (std::string_view f : fields) {
+        total += f.size();
+    }
+    record.normalized.clear();
+    record.normalized.reserve(total);
+    auto normalize = [&record](std::string_view field) {
+        size_t offset = record.normalized.size();
+        if constexpr (Dialect::upperIds) {
+            appendUpper(record.normalized, field);
+        } else {
+            record.normalized.append(field.data(), field.size());
+        }
+        return std::string_view(record.normalized).substr(offset);
+    };
+
+    record.line = lineNum;
+    record.id = normalize(fields[0]);
+    record.title = fields[1]; // Keep original case for title
+
+    if (record.id.empty()) {
+        warn(lineNum, "skipped: empty course ID");
+        return false;
+    }
+    if (record.title.empty()) {
+        warn(lineNum, std::string("has empty title for course ").append(record.id));
+    }
+
+    // Handle prerequisites (fields[2..])
+    record.prereqs.clear();
+    for (size_t i = 2; i < fields.size(); ++i) {
+        if (!fields[i].empty()) {
+            record.prereqs.push_back(normalize(fields[i]));
+        }
+    }
+    return true;
+}
+
+// Apply one record to the catalog. Strings are only copied here, when a
+// course is actually stored.
+inline void applyCourseRecord(const CourseRecord& record, Catalog& catalog) {
+    // Ensure a Course object exists for this ID
+    uint32_t handle = catalog.intern(record.id);
+    catalog.define(handle, static_cast<uint32_t>(record.line));
+    if (!record.title.empty()) {
+        catalog.setTitle(handle, record.title);
+    }
+    for (std::string_view prereq : record.prereqs) {
+        // Interning creates a placeholder so the title can be resolved later if defined elsewhere
+        catalog.addPrereq(handle, catalog.intern(prereq));
+    }
+}
+
+// Default block size for streamCourseRecords
+static const size_t kStreamBufferBytes = 64 * 1024;
+
+// streamCourseRecords, continuing from a buffer whose first `filled` bytes
+// were already read from in (e.g. to detect the file format)
+template <typename Dialect, typename OnRecord, typename OnWarning>
+void streamCourseRecordsFrom(std::istream& in, std::vector<char>& buffer, size_t filled, OnRecord&& onRecord,
+                             OnWarning&& onWarning) {
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    CourseRecord record;
+    size_t lineNum = 0;
+    bool atEnd = false;
+    while (true) {
+        if (!atEnd) {
+            in.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+            filled += static_cast<size_t>(in.gcount());
+            atEnd = !in;
+        }
+        const char* pos = buffer.data();
+        const char* end = pos + filled;
+        while (pos != end) {
+            const char* nl = findEither(pos, end, '\n', '\n');
+            if (nl == end && !atEnd) {
+                break; // the rest of this line is in the next block
+            }
+            std::string_view line(pos, static_cast<size_t>(nl - pos));
+            pos = (nl == end) ? end : nl + 1;
+
+            ++lineNum;
+            // Skip empty lines
+            if (trimView(line).empty()) {
+                continue;
+            }
+            splitFields<Dialect>(line, fields, scratch);
+            if (readCourseRecord<Dialect>(lineNum, fields, record, onWarning)) {
+                onRecord(static_cast<const CourseRecord&>(record));
+            }
+        }
+        if (atEnd) {
+            return;
+        }
+        filled = static_cast<size_t>(end - pos);
+        std::memmove(buffer.data(), pos, filled);
+        if (filled == buffer.size()) {
+            buffer.resize(buffer.size() * 2); // one line fills the whole block
+        }
+    }
+}
+
+// Parse in record by record without keeping any of it: each valid record goes
+// to onRecord(const CourseRecord&) and each problem to onWarning(line, message)
+// as soon as it is found. Input is read in blocks of bufferBytes, so memory
+// stays bounded by the block plus the longest line, whatever the input size.
+// Lines split like std::getline; fields split as Dialect says.
+template <typename Dialect = CommaDialect, typename OnRecord, typename OnWarning>
+void streamCourseRecords(std::istream& in, OnRecord&& onRecord, OnWarning&& onWarning,
+                         size_t bufferBytes = kStreamBufferBytes) {
+    std::vector<char> buffer(std::max<size_t>(bufferBytes, 1));
+    streamCourseRecordsFrom<Dialect>(in, buffer, 0, onRecord, onWarning);
+}
+
+// streamCourseRecords over a file. Returns false if it cannot be opened.
+template <typename Dialect = CommaDialect, typename OnRecord, typename OnWarning>
+bool streamCourseRecords(const std::string& filename, OnRecord&& onRecord, OnWarning&& onWarning,
+                         size_t bufferBytes = kStreamBufferBytes) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        std::cerr << "Error: Could not open file: " << filename << std::endl;
+        return false;
+    }
+    streamCourseRecords<Dialect>(in, onRecord, onWarning, bufferBytes);
+    return true;
+}
+
+enum class Compression { None, Gzip, Zstd };
+
+// Compression of a file, from its first bytes
+inline Compression detectCompression(std::string_view data) {
+    if (data.size() >= 2 && data[0] == '\x1f' && data[1] == '\x8b') {
+        return Compression::Gzip;
+    }
+    if (data.size() >= 4 && std::memcmp(data.data(), "\x28\xb5\x2f\xfd", 4) == 0) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+inline const char* compressionName(Compression compression) {
+    return compression == Compression::Gzip ? "gzip" : compression == Compression::Zstd ? "zstd" : "plain";
+}
+
+// Bounded single-producer, single-consumer queue of fixed-size byte blocks.
+// The producer fills the block from acquire() and publishes it; the consumer
+// reads one block at a time through next(), which hands the previous one
+// back. Neither side copies, and at most `blocks` blocks are ever in flight.
+class BlockRing {
+public:
+    BlockRing(size_t blocks, size_t blockBytes)
+        : blocks_(std::max<size_t>(blocks, 2), std::vector<char>(blockBytes)), sizes_(blocks_.size(), 0) {}
+
+    size_t blockBytes() const { return blocks_[0].size(); }
+
+    // Producer: the next block to fill, or null once the consumer has cancelled
+    char* acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return filled_ < blocks_.size() || cancelled_; });
+        return cancelled_ ? nullptr : blocks_[tail_].data();
+    }
+
+    // Producer: publish the block from acquire() holding bytes bytes
+    void publish(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        published_ += bytes;
+        sizes_[tail_] = bytes;
+        tail_ = (tail_ + 1) % blocks_.size();
+        ++filled_;
+        changed_.notify_all();
+    }
+
+    // Producer: no more blocks; ok=false when the data ended in an error
+    void finish(bool ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        ok_ = ok;
+        changed_.notify_all();
+    }
+
+    // Consumer: release the block it holds and wait for the next one; false at the end
+    bool next(const char*& data, size_t& bytes) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (holding_) {
+            head_ = (head_ + 1) % blocks_.size();
+            --filled_;
+            holding_ = false;
+            changed_.notify_all();
+        }
+        changed_.wait(lock, [this] { return filled_ != 0 || finished_; });
+        if (filled_ == 0) {
+            return false;
+        }
+        holding_ = true;
+        data = blocks_[head_].data();
+        bytes = sizes_[head_];
+        return true;
+    }
+
+    // Consumer: stop the producer, e.g. when parsing ends early
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        changed_.notify_all();
+    }
+
+    // True unless the producer finished with an error; valid once next() returned false
+    bool ok() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ok_;
+    }
+
+    // Bytes published so far
+    uint64_t published() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return published_;
+    }
+
+private:
+    std::vector<std::vector<char>> blocks_;
+    std::vector<size_t> sizes_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    size_t head_ = 0;   // oldest published block
+    size_t tail_ = 0;   // next block to fill
+    size_t filled_ = 0; // published and not yet released, including the one the consumer holds
+    bool holding_ = false;
+    bool finished_ = false;
+    bool cancelled_ = false;
+    bool ok_ = true;
+    uint64_t published_ = 0;
+};
+
+// Input stream over the blocks of a BlockRing, so the streaming parser can
+// read decompressed data as it arrives
+class BlockRingStreamBuf : public std::streambuf {
+public:
+    explicit BlockRingStreamBuf(BlockRing& ring) : ring_(ring) {}
+
+protected:
+    int_type underflow() override {
+        const char* data = nullptr;
+        size_t bytes = 0;
+        do {
+            if (!ring_.next(data, bytes)) {
+                return traits_type::eof();
+            }
+        } while (bytes == 0);
+        char* p = const_cast<char*>(data); // get area is only read
+        setg(p, p, p + bytes);
+        return traits_type::to_int_type(*p);
+    }
+
+private:
+    BlockRing& ring_;
+};
+
+// Decompress data into ring, block by block, then finish() it. Concatenated
+// gzip members and zstd frames are all decoded. Returns false, with the
+// reason in error, for corrupt or truncated input or a codec this build lacks.
+inline bool decompressInto(Compression compression, std::string_view data, BlockRing& ring, std::string& error) {
+    (void)data; // unused when neither codec is built in
+    bool ok = false;
+    if (compression == Compression::Gzip) {
+#ifdef ABCU_ENABLE_ZLIB
+        z_stream z{};
+        ok = inflateInit2(&z, 15 + 32) == Z_OK; // 15-bit window, gzip or zlib header
+        if (!ok) {
+            error = "could not start zlib";
+        }
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        z.avail_in = 0;
+        size_t offset = 0;
+        bool ended = false;
+        while (ok) {
+            char* out = ring.acquire();
+            if (out == nullptr) {
+                break; // the consumer stopped reading
+            }
+            z.next_out = reinterpret_cast<Bytef*>(out);
+            z.avail_out = static_cast<uInt>(ring.blockBytes());
+            while (z.avail_out != 0) {
+                if (z.avail_in == 0 && offset < data.size()) {
+                    // avail_in is 32 bits, so large files are fed in pieces
+                    z.avail_in = static_cast<uInt>(std::min<size_t>(data.size() - offset, 1u << 30));
+                    offset += z.avail_in;
+                }
+                if (ended) {
+                    if (z.avail_in == 0) {
+                        break;
+                    }
+                    inflateReset(&z); // another gzip member follows
+                    ended = false;
+                }
+                int rc = inflate(&z, Z_NO_FLUSH);
+                if (rc == Z_STREAM_END) {
+                    ended = true;
+                } else if (rc == Z_BUF_ERROR && z.avail_in == 0 && offset == data.size()) {
+                    ok = false;
+                    error = "gzip data is truncated";
+                    break;
+                } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                    ok = false;
+                    error = std::string("gzip data is corrupt (") + (z.msg != nullptr ? z.msg : "inflate failed") + ")";
+                    break;
+                }
+            }
+            size_t produced = ring.blockBytes() - z.avail_out;
+            ring.publish(produced);
+            if (!ok || (ended && z.avail_in == 0 && offset == data.size())) {
+                break;
+            }
+        }
+        inflateEnd(&z);
+#else
+        error = "gzip input needs a build with -DABCU_ENABLE_ZLIB (and -lz)";
+#endif
+    } else if (compression == Compression::Zstd) {
+#ifdef ABCU_ENABLE_ZSTD
+        ZSTD_DCtx* ctx = ZSTD_createDCtx();
+        ok = ctx != nullptr;
+        if (!ok) {
+            error = "could not start zstd";
+        }
+        ZSTD_inBuffer in{data.data(), data.size(), 0};
+        size_t pending = 0; // nonzero while a frame is incomplete
+        while (ok) {
+            char* out = ring.acquire();
+            if (out == nullptr) {
+                break;
+            }
+            ZSTD_outBuffer block{out, ring.blockBytes(), 0};
+            while (block.pos < block.size && (in.pos < in.size || pending != 0)) {
+                size_t before = block.pos;
+                pending = ZSTD_decompressStream(ctx, &block, &in);
+                if (ZSTD_isError(pending)) {
+                    ok = false;
+                    error = std::string("zstd data is corrupt (") + ZSTD_getErrorName(pending) + ")";
+                    break;
+                }
+                if (in.pos == in.size && block.pos == before && pending != 0) {
+                    ok = false; // no input left and no progress: the frame was cut short
+                    error = "zstd data is truncated";
+                    break;
+                }
+            }
+            ring.publish(block.pos);
+            if (!ok || (in.pos == in.size && pending == 0)) {
+                break;
+            }
+        }
+        ZSTD_freeDCtx(ctx);
+#else
+        error = "zstd input needs a build with -DABCU_ENABLE_ZSTD (and -lzstd)";
+#endif
+    } else {
+        error = "input is not compressed";
+    }
+    ring.finish(ok);
+    return ok;
+}
+
+// Courses, warnings and line count parsed from one slice of the file
+struct CatalogChunk {
+    Catalog catalog;
+    std::vector<LineWarning> warnings;
+    size_t lineCount = 0;
+    LoadMetrics metrics; // this chunk's share of the parse counters
+};
+
+// Parse every line of data into chunk. Same line splitting as std::getline:
+// split on '\n', no empty line after a trailing newline.
+template <typename Dialect = CommaDialect>
+void parseCatalogChunk(std::string_view data, CatalogChunk& chunk) {
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    CourseRecord record;
+    auto warn = [&chunk](size_t line, std::string_view message) {
+        chunk.warnings.push_back({line, std::string(message)});
+    };
+    const char* pos = data.data();
+    const char* end = pos + data.size();
+    while (pos != end) {
+        const char* nl = findEither(pos, end, '\n', '\n');
+        std::string_view line(pos, static_cast<size_t>(nl - pos));
+        pos = (nl == end) ? end : nl + 1;
+
+        ++chunk.lineCount;
+        // Skip empty lines
+        if (trimView(line).empty()) {
+            continue;
+        }
+        {
+            ABCU_SCOPED_TIMER(chunk.metrics.splitNs);
+            splitFields<Dialect>(line, fields, scratch);
+        }
+        bool valid;
+        {
+            ABCU_SCOPED_TIMER(chunk.metrics.normalizeNs);
+            valid = readCourseRecord<Dialect>(chunk.lineCount, fields, record, warn);
+        }
+        if (valid) {
+            ABCU_SCOPED_TIMER(chunk.metrics.insertNs);
+            ABCU_COUNT(chunk.metrics.records, 1);
+            applyCourseRecord(record, chunk.catalog);
+        }
+    }
+}
+
+// Split data into up to `parts` slices that each end just after a newline.
+// Records never span lines (the parser works line by line, like std::getline),
+// so every newline is a safe boundary, even one inside an open quote.
+inline std::vector<std::string_view> splitAtLineBoundaries(std::string_view data, size_t parts) {
+    std::vector<std::string_view> slices;
+    size_t start = 0;
+    for (size_t k = 1; k < parts && start < data.size(); ++k) {
+        size_t target = std::max(start, data.size() * k / parts);
+        size_t nl = data.find('\n', target);
+        if (nl == std::string_view::npos) {
+            break;
+        }
+        slices.push_back(data.substr(start, nl + 1 - start));
+        start = nl + 1;
+    }
+    if (start < data.size()) {
+        slices.push_back(data.substr(start));
+    }
+    return slices;
+}
+
+// Fold a chunk into the catalog as if its lines had followed the ones already
+// loaded: a non-empty title overrides, prereqs append in file order, and
+// placeholders only fill gaps. lineBase shifts chunk-local line numbers, and
+// a chunk's first definition of a course already defined becomes a duplicate.
+inline void mergeCatalogChunk(CatalogChunk& chunk, size_t lineBase, Catalog& catalog,
+                              std::vector<LineWarning>& warnings) {
+    // Local handles follow first appearance within the chunk, so interning them
+    // in order hands out the same global handles a sequential load would.
+    std::vector<uint32_t> toGlobal(chunk.catalog.size());
+    for (uint32_t local = 0; local < toGlobal.size(); ++local) {
+        toGlobal[local] = catalog.intern(chunk.catalog.id(local));
+    }
+    for (uint32_t local = 0; local < toGlobal.size(); ++local) {
+        std::string_view title = chunk.catalog.title(local);
+        if (!title.empty()) {
+            catalog.setTitle(toGlobal[local], title);
+        }
+        if (chunk.catalog.definitionLine(local) != 0) {
+            catalog.define(toGlobal[local], chunk.catalog.definitionLine(local) + static_cast<uint32_t>(lineBase));
+        }
+    }
+    for (const DuplicateDefinition* d = chunk.catalog.duplicatesBegin(); d != chunk.catalog.duplicatesEnd(); ++d) {
+        catalog.define(toGlobal[d->course], d->line + static_cast<uint32_t>(lineBase));
+    }
+    // Chunk edges are in file order, so appending them keeps the global order too
+    for (const PrereqEdge& e : chunk.catalog.pendingPrereqs()) {
+        catalog.addPrereq(toGlobal[e.course], toGlobal[e.prereq]);
+    }
+    chunk.catalog.clear();
+    for (LineWarning& w : chunk.warnings) {
+        w.line += lineBase;
+        warnings.push_back(std::move(w));
+    }
+}
+
+// Identity of a source CSV, used to tell whether a snapshot is still current
+struct SourceFingerprint {
+    uint64_t size = 0;
+    int64_t mtime = 0; // filesystem clock ticks
+    uint64_t hash = 0; // hashBytes() of the whole file
+    uint32_t format = 0; // fileFormatCode() of the requested format, Auto included
+};
+
+inline uint64_t rotateLeft(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Fast 64-bit content hash (MurmurHash3-style mixing, 8 bytes per step)
+inline uint64_t hashBytes(std::string_view data) {
+    const uint64_t c1 = 0x87c37b91114253d5ull;
+    const uint64_t c2 = 0x4cf5ad432745937full;
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ data.size();
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t k;
+        std::memcpy(&k, data.data() + i, sizeof(k));
+        h ^= rotateLeft(k * c1, 31) * c2;
+        h = rotateLeft(h, 27) * 5 + 0x52dce729;
+    }
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < data.size(); ++j) {
+        tail |= static_cast<uint64_t>(static_cast<unsigned char>(data[i + j])) << (8 * j);
+    }
+    h ^= rotateLeft(tail * c1, 31) * c2;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Size and modification time of filename; the hash is filled in separately
+inline bool sourceFingerprint(const std::string& filename, SourceFingerprint& source) {
+    std::error_code ec;
+    source.size = std::filesystem::file_size(filename, ec);
+    if (ec) {
+        return false;
+    }
+    auto mtime = std::filesystem::last_write_time(filename, ec);
+    if (ec) {
+        return false;
+    }
+    source.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return true;
+}
+
+// A snapshot is the catalog's columns and the warning list written back to
+// back (native byte order, each section 8-byte aligned) after this header.
+// Opening one maps the file and points the catalog's columns straight into it.
+static const char kSnapshotMagic[8] = {'A', 'B', 'C', 'U', 'S', 'N', 'A', 'P'};
+static const uint32_t kSnapshotVersion = 3;
+static const uint32_t kSnapshotByteOrder = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // kSnapshotByteOrder as stored by the writing machine
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+    uint32_t courseCount;
+    uint32_t edgeCount;
+    uint32_t sortedCount;
+    uint32_t warningCount;
+    uint64_t textBytes;
+    uint64_t warningBytes;
+    uint32_t duplicateCount;
+    uint32_t format; // SourceFingerprint::format
+};
+
+// Byte offsets of each snapshot section, derived from the header counts
+struct SnapshotLayout {
+    uint64_t text, ids, titles, prereqOffsets, prereqs, sorted, defLines, duplicates, warningRefs, warningText, total;
+};
+
+inline uint64_t alignTo8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+inline SnapshotLayout snapshotLayout(const SnapshotHeader& h) {
+    SnapshotLayout l;
+    l.text = alignTo8(sizeof(SnapshotHeader));
+    l.ids = alignTo8(l.text + h.textBytes);
+    l.titles = alignTo8(l.ids + uint64_t(h.courseCount) * sizeof(TextRef));
+    l.prereqOffsets = alignTo8(l.titles + uint64_t(h.courseCount) * sizeof(TextRef));
+    l.prereqs = alignTo8(l.prereqOffsets + (uint64_t(h.courseCount) + 1) * sizeof(uint32_t));
+    l.sorted = alignTo8(l.prereqs + uint64_t(h.edgeCount) * sizeof(uint32_t));
+    l.defLines = alignTo8(l.sorted + uint64_t(h.sortedCount) * sizeof(uint32_t));
+    l.duplicates = alignTo8(l.defLines + uint64_t(h.courseCount) * sizeof(uint32_t));
+    l.warningRefs = alignTo8(l.duplicates + uint64_t(h.duplicateCount) * sizeof(DuplicateDefinition));
+    l.warningText = alignTo8(l.warningRefs + uint64_t(h.warningCount) * sizeof(TextRef));
+    l.total = l.warningText + h.warningBytes;
+    return l;
+}
+
+// Snapshot file that belongs to a CSV file
+inline std::string snapshotPath(const std::string& filename) { return filename + ".snap"; }
+
+// Write a finalized catalog and its load warnings to path. The file is
+// written under a temporary name and renamed, so readers never see half of it.
+inline bool writeCatalogSnapshot(const std::string& path, const Catalog& catalog,
+                                 const std::vector<std::string>& warnings, const SourceFingerprint& source) {
+    const CatalogArrays& a = catalog.arrays();
+    std::vector<TextRef> warningRefs;
+    std::string warningText;
+    for (const std::string& w : warnings) {
+        warningRefs.push_back({static_cast<uint32_t>(warningText.size()), static_cast<uint32_t>(w.size())});
+        warningText += w;
+    }
+
+    SnapshotHeader h;
+    std::memcpy(h.magic, kSnapshotMagic, sizeof(h.magic));
+    h.version = kSnapshotVersion;
+    h.byteOrder = kSnapshotByteOrder;
+    h.sourceSize = source.size;
+    h.sourceMtime = source.mtime;
+    h.sourceHash = source.hash;
+    h.courseCount = a.courseCount;
+    h.edgeCount = a.edgeCount;
+    h.sortedCount = a.sortedCount;
+    h.warningCount = static_cast<uint32_t>(warningRefs.size());
+    h.textBytes = a.textBytes;
+    h.warningBytes = warningText.size();
+    h.duplicateCount = a.duplicateCount;
+    h.format = source.format;
+    SnapshotLayout l = snapshotLayout(h);
+
+    std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    uint64_t written = 0;
+    auto section = [&](uint64_t offset, const void* data, uint64_t bytes) {
+        static const char zeros[8] = {};
+        out.write(zeros, static_cast<std::streamsize>(offset - written)); // alignment padding
+        if (bytes != 0) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        }
+        written = offset + bytes;
+    };
+    static const uint32_t kNoOffsets = 0; // a catalog with no courses still has one offset
+    section(0, &h, sizeof(h));
+    section(l.text, a.text, a.textBytes);
+    section(l.ids, a.ids, uint64_t(a.courseCount) * sizeof(TextRef));
+    section(l.titles, a.titles, uint64_t(a.courseCount) * sizeof(TextRef));
+    section(l.prereqOffsets, a.prereqOffsets != nullptr ? a.prereqOffsets : &kNoOffsets,
+            (uint64_t(a.courseCount) + 1) * sizeof(uint32_t));
+    section(l.prereqs, a.prereqs, uint64_t(a.edgeCount) * sizeof(uint32_t));
+    section(l.sorted, a.sorted, uint64_t(a.sortedCount) * sizeof(uint32_t));
+    section(l.defLines, a.defLines, uint64_t(a.courseCount) * sizeof(uint32_t));
+    section(l.duplicates, a.duplicates, uint64_t(a.duplicateCount) * sizeof(DuplicateDefinition));
+    section(l.warningRefs, warningRefs.data(), uint64_t(warningRefs.size()) * sizeof(TextRef));
+    section(l.warningText, warningText.data(), warningText.size());
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Attach the snapshot at path to catalog if it was written for this exact
+// source, parsed in the same format: same size and mtime, or (after a touch
+// or copy) same content hash, which is only computed from sourceData when the
+// mtime differs. Every offset
+// and handle is bounds-checked once, so a damaged file is rejected, not trusted.
+inline bool openCatalogSnapshot(const std::string& path, const SourceFingerprint& source, std::string_view sourceData,
+                                Catalog& catalog, std::vector<std::string>& warnings) {
+    auto file = std::make_unique<MappedFile>(path);
+    std::string_view bytes = file->view();
+    if (!file->valid() || bytes.size() < sizeof(SnapshotHeader)) {
+        return false;
+    }
+    SnapshotHeader h;
+    std::memcpy(&h, bytes.data(), sizeof(h));
+    if (std::memcmp(h.magic, kSnapshotMagic, sizeof(h.magic)) != 0 || h.version != kSnapshotVersion ||
+        h.byteOrder != kSnapshotByteOrder || h.sourceSize != source.size || h.format != source.format) {
+        return false;
+    }
+    if (h.sourceMtime != source.mtime && h.sourceHash != hashBytes(sourceData)) {
+        return false;
+    }
+    SnapshotLayout l = snapshotLayout(h);
+    if (l.total != bytes.size()) {
+        return false;
+    }
+
+    const char* base = bytes.data();
+    CatalogArrays a;
+    a.text = base + l.text;
+    a.textBytes = h.textBytes;
+    a.ids = reinterpret_cast<const TextRef*>(base + l.ids);
+    a.titles = reinterpret_cast<const TextRef*>(base + l.titles);
+    a.courseCount = h.courseCount;
+    a.prereqOffsets = reinterpret_cast<const uint32_t*>(base + l.prereqOffsets);
+    a.prereqs = reinterpret_cast<const uint32_t*>(base + l.prereqs);
+    a.edgeCount = h.edgeCount;
+    a.sorted = reinterpret_cast<const uint32_t*>(base + l.sorted);
+    a.sortedCount = h.sortedCount;
+    a.defLines = reinterpret_cast<const uint32_t*>(base + l.defLines);
+    a.duplicates = reinterpret_cast<const DuplicateDefinition*>(base + l.duplicates);
+    a.duplicateCount = h.duplicateCount;
+    const TextRef* warningRefs = reinterpret_cast<const TextRef*>(base + l.warningRefs);
+    const char* warningText = base + l.warningText;
+
+    auto refInBounds = [](const TextRef& r, uint64_t limit) { return uint64_t(r.offset) + r.length <= limit; };
+    for (uint32_t i = 0; i < h.courseCount; ++i) {
+        if (!refInBounds(a.ids[i], h.textBytes) || !refInBounds(a.titles[i], h.textBytes) ||
+            a.prereqOffsets[i] > a.prereqOffsets[i + 1]) {
+            return false;
+        }
+    }
+    if (a.prereqOffsets[0] != 0 || a.prereqOffsets[h.courseCount] != h.edgeCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < h.edgeCount; ++i) {
+        if (a.prereqs[i] >= h.courseCount) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.sortedCount; ++i) {
+        if (a.sorted[i] >= h.courseCount) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.duplicateCount; ++i) {
+        if (a.duplicates[i].course >= h.courseCount) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.warningCount; ++i) {
+        if (!refInBounds(warningRefs[i], h.warningBytes)) {
+            return false;
+        }
+    }
+
+    warnings.clear();
+    warnings.reserve(h.warningCount);
+    for (uint32_t i = 0; i < h.warningCount; ++i) {
+        warnings.emplace_back(warningText + warningRefs[i].offset, warningRefs[i].length);
+    }
+    catalog.attach(std::move(file), a);
+    return true;
+}
+
+// Field delimiter of a catalog file; Auto decides from the first lines
+enum class FieldDelimiter { Auto, Comma, Tab, Pipe };
+
+// Runtime choice of CsvDialect. Comma files use '"' quoting; tab- and
+// pipe-delimited exports are read without quoting.
+struct FileFormat {
+    FieldDelimiter delimiter = FieldDelimiter::Auto;
+    bool trim = true;
+    bool upperIds = true;
+};
+
+// Non-empty lines looked at when detecting the delimiter
+static const size_t kFormatSampleLines = 16;
+
+// Delimiter of the first non-empty lines of data, counting only separators
+// outside quotes. Comma wins ties: tabs are chosen only when they are
+// strictly more common than commas, and tabs next to a comma (through other
+// whitespace) count as padding, so a comma file with tab-padded fields stays
+// a comma file. Pipes win when strictly more common than commas.
+inline FieldDelimiter detectDelimiter(std::string_view data) {
+    size_t commas = 0, tabs = 0, pipes = 0;
+    size_t lines = 0;
+    bool inQuotes = false;
+    bool blank = true;
+    size_t runTabs = 0;        // unquoted tabs in the current whitespace run
+    bool runAfterComma = false; // that run directly follows a comma
+    bool lastWasComma = false;
+    for (size_t i = 0; i < data.size() && lines < kFormatSampleLines; ++i) {
+        char ch = data[i];
+        if (ch == '\n') {
+            tabs += runAfterComma ? 0 : runTabs;
+            runTabs = 0;
+            runAfterComma = false;
+            lastWasComma = false;
+            lines += blank ? 0 : 1;
+            blank = true;
+            inQuotes = false; // records never span lines
+            continue;
+        }
+        blank = blank && std::isspace(static_cast<unsigned char>(ch));
+        if (!inQuotes && (ch == ' ' || ch == '\t' || ch == '\r')) {
+            if (runTabs == 0 && ch == '\t') {
+                runAfterComma = lastWasComma;
+            }
+            runTabs += ch == '\t' ? 1 : 0;
+            continue;
+        }
+        // The whitespace run ends here; it was padding if a comma touches either side
+        bool comma = ch == ',' && !inQuotes;
+        tabs += (runAfterComma || comma) ? 0 : runTabs;
+        runTabs = 0;
+        runAfterComma = false;
+        lastWasComma = comma;
+        if (ch == '"') {
+            inQuotes = !inQuotes;
+        } else if (comma) {
+            ++commas;
+        } else if (ch == '|' && !inQuotes) {
+            ++pipes;
+        }
+    }
+    tabs += runAfterComma ? 0 : runTabs; // data ended inside a run
+    if (tabs > commas && tabs >= pipes) {
+        return FieldDelimiter::Tab;
+    }
+    return pipes > commas ? FieldDelimiter::Pipe : FieldDelimiter::Comma;
+}
+
+// format with Auto replaced by the delimiter detected in sample (the start of the file)
+inline FileFormat resolveFileFormat(FileFormat format, std::string_view sample) {
+    if (format.delimiter == FieldDelimiter::Auto) {
+        format.delimiter = detectDelimiter(sample);
+    }
+    return format;
+}
+
+// Stable code for a resolved format; snapshots record the one they were parsed with
+inline uint32_t fileFormatCode(const FileFormat& format) {
+    return static_cast<uint32_t>(format.delimiter) | (format.trim ? 0x100u : 0u) | (format.upperIds ? 0x200u : 0u);
+}
+
+template <char Delimiter, char Quote, typename F>
+void withDialectFlags(const FileFormat& format, F& f) {
+    if (format.trim && format.upperIds) {
+        f(CsvDialect<Delimiter, Quote, true, true>());
+    } else if (format.trim) {
+        f(CsvDialect<Delimiter, Quote, true, false>());
+    } else if (format.upperIds) {
+        f(CsvDialect<Delimiter, Quote, false, true>());
+    } else {
+        f(CsvDialect<Delimiter, Quote, false, false>());
+    }
+}
+
+// Call f(Dialect()) with the CsvDialect instantiation for a resolved format,
+// so the per-line loops run with the choice fixed at compile time
+template <typename F>
+void withDialect(const FileFormat& format, F&& f) {
+    switch (format.delimiter) {
+    case FieldDelimiter::Tab:
+        withDialectFlags<'\t', '\0'>(format, f);
+        break;
+    case FieldDelimiter::Pipe:
+        withDialectFlags<'|', '\0'>(format, f);
+        break;
+    default: // Comma, or Auto when the caller did not resolve it
+        withDialectFlags<',', '"'>(format, f);
+        break;
+    }
+}
+
+// Options for loadCoursesFromFile
+struct LoadOptions {
+    // Worker threads for parsing a mapped file; 0 picks one per core for large
+    // files. Streamed input is always parsed on the calling thread.
+    unsigned threads = 0;
+
+    // Serve the load from FILE.snap when it matches the CSV, and refresh the
+    // snapshot after parsing when it does not
+    bool useSnapshot = false;
+
+    // Delimiter, trimming and ID case of the file; by default the delimiter
+    // is detected from its first lines
+    FileFormat format;
+
+    // Run Catalog::compact() on the parsed catalog, trading a copy of its
+    // strings for a tighter footprint while it is served
+    bool compact = true;
+
+    // Filled in after each load when set; stays zero unless built with ABCU_ENABLE_METRICS
+    LoadMetrics* metrics = nullptr;
+};
+
+// Files below this size are parsed on one thread, where start-up costs dominate
+static const size_t kMinBytesPerWorker = 1 << 20;
+
+// Decompressed data in flight between the decompressing and parsing threads
+static const size_t kRingBlocks = 8;
+static const size_t kRingBlockBytes = 256 * 1024;
+
+// Parse all of the input into catalog, which may already hold interned IDs,
+// and replace warnings with the load warnings. Reads the mapping when valid,
+// otherwise the stream. A compressed mapping is decompressed on a second
+// thread and parsed as it streams in through a BlockRing. Returns false,
+// after reporting it, when compressed input cannot be decompressed. The
+// caller finalizes the catalog.
+inline bool parseCatalogInput(const std::string& filename, const MappedFile& mapped, std::istream& in,
+                              Catalog& catalog, std::vector<std::string>& warnings, const LoadOptions& options,
+                              LoadMetrics& metrics) {
+    std::vector<LineWarning> lineWarnings;
+    auto parseStream = [&](std::istream& source) {
+        ABCU_SCOPED_TIMER(metrics.splitNs);
+        // The format is detected from the first block, which the parser then continues from
+        std::vector<char> buffer(kStreamBufferBytes);
+        source.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        size_t filled = static_cast<size_t>(source.gcount());
+        FileFormat format = resolveFileFormat(options.format, std::string_view(buffer.data(), filled));
+        withDialect(format, [&](auto dialect) {
+            streamCourseRecordsFrom<decltype(dialect)>(
+                source, buffer, filled,
+                [&](const CourseRecord& record) {
+                    ABCU_COUNT(metrics.records, 1);
+                    applyCourseRecord(record, catalog);
+                },
+                [&lineWarnings](size_t line, std::string_view message) {
+                    lineWarnings.push_back({line, std::string(message)});
+                });
+        });
+    };
+
+    Compression compression = mapped.valid() ? detectCompression(mapped.view()) : Compression::None;
+    if (compression != Compression::None) {
+        BlockRing ring(kRingBlocks, kRingBlockBytes);
+        std::string error;
+        std::thread decompressor([&] {
+            ABCU_SCOPED_TIMER(metrics.decompressNs);
+            decompressInto(compression, mapped.view(), ring, error);
+        });
+        BlockRingStreamBuf ringBuffer(ring);
+        std::istream decompressed(&ringBuffer);
+        parseStream(decompressed);
+        ring.cancel(); // nothing left to read; unblocks the decompressor if it is still waiting
+        decompressor.join();
+        metrics.decompressedBytes = ring.published();
+        if (!ring.ok()) {
+            std::cerr << "Error: Could not decompress " << filename << ": " << error << std::endl;
+            return false;
+        }
+    } else if (mapped.valid()) {
+        std::string_view data = mapped.view();
+        size_t workers = options.threads;
+        if (workers == 0) {
+            workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), data.size() / kMinBytesPerWorker);
+        }
+        std::vector<std::string_view> slices = splitAtLineBoundaries(data, std::max<size_t>(workers, 1));
+
+        std::vector<CatalogChunk> chunks(slices.size());
+        withDialect(resolveFileFormat(options.format, data), [&](auto dialect) {
+            using Dialect = decltype(dialect);
+            std::vector<std::thread> pool;
+            for (size_t i = 1; i < slices.size(); ++i) {
+                pool.emplace_back(parseCatalogChunk<Dialect>, slices[i], std::ref(chunks[i]));
+            }
+            if (!slices.empty()) {
+                parseCatalogChunk<Dialect>(slices[0], chunks[0]);
+            }
+            for (std::thread& t : pool) {
+                t.join();
+            }
+        });
+
+        ABCU_SCOPED_TIMER(metrics.mergeNs);
+        size_t lineBase = 0;
+        for (CatalogChunk& chunk : chunks) {
+            metrics += chunk.metrics;
+            mergeCatalogChunk(chunk, lineBase, catalog, lineWarnings);
+            lineBase += chunk.lineCount;
+        }
+    } else {
+        parseStream(in);
+    }
+
+    // Chunks are merged in file order, so warnings are already sorted by line
+    ABCU_SCOPED_TIMER(metrics.warningNs);
+    ABCU_COUNT(metrics.warnings, lineWarnings.size());
+    warnings.clear();
+    warnings.reserve(lineWarnings.size());
+    for (const LineWarning& w : lineWarnings) {
+        warnings.push_back("Line " + std::to_string(w.line) + " " + w.message);
+    }
+    return true;
+}
+
+// Number of courses that are referenced as prereqs but have no title
+inline uint64_t countPlaceholders(const Catalog& catalog) {
+    const CatalogArrays& a = catalog.arrays();
+    std::vector<bool> referenced(a.courseCount, false);
+    for (uint32_t i = 0; i < a.edgeCount; ++i) {
+        referenced[a.prereqs[i]] = true;
+    }
+    uint64_t count = 0;
+    for (uint32_t h = 0; h < a.courseCount; ++h) {
+        count += (referenced[h] && catalog.title(h).empty()) ? 1 : 0;
+    }
+    return count;
+}
+
+// loadCoursesFromFile, recording into metrics
+inline bool loadCoursesFromFile(const std::string& filename, Catalog& catalog, std::vector<std::string>& warnings,
+                                const LoadOptions& options, LoadMetrics& metrics) {
+    MappedFile mapped = [&] {
+        ABCU_SCOPED_TIMER(metrics.openNs);
+        return MappedFile(filename);
+    }();
+    std::ifstream in;
+    if (!mapped.valid()) {
+        in.open(filename);
+        if (!in) {
+            std::cerr << "Error: Could not open file: " << filename << std::endl;
+            return false;
+        }
+    }
+    metrics.bytes = mapped.valid() ? mapped.view().size() : 0;
+
+    // Snapshots are only kept for regular files, which are always mappable
+    SourceFingerprint source;
+    bool snapshots = options.useSnapshot && mapped.valid() && sourceFingerprint(filename, source);
+    if (snapshots) {
+        source.format = fileFormatCode(options.format); // same bytes, same detected delimiter
+        ABCU_SCOPED_TIMER(metrics.snapshotNs);
+        if (openCatalogSnapshot(snapshotPath(filename), source, mapped.view(), catalog, warnings)) {
+            metrics.fromSnapshot = true;
+            ABCU_COUNT(metrics.warnings, warnings.size());
+            ABCU_COUNT(metrics.placeholders, countPlaceholders(catalog));
+            return true;
+        }
+    }
+
+    catalog.clear();
+    if (!parseCatalogInput(filename, mapped, in, catalog, warnings, options, metrics)) {
+        catalog.clear();
+        return false;
+    }
+    {
+        ABCU_SCOPED_TIMER(metrics.finalizeNs);
+        catalog.finalize();
+    }
+    if (options.compact) {
+        ABCU_SCOPED_TIMER(metrics.compactNs);
+        catalog.compact();
+    }
+    ABCU_COUNT(metrics.placeholders, countPlaceholders(catalog));
+
+    if (snapshots) {
+        ABCU_SCOPED_TIMER(metrics.snapshotNs);
+        source.hash = hashBytes(mapped.view());
+        if (!writeCatalogSnapshot(snapshotPath(filename), catalog, warnings, source)) {
+            std::cerr << "Warning: could not write snapshot " << snapshotPath(filename) << std::endl;
+        }
+    }
+    return true;
+}
+
+// Load courses from a CSV file into the provided catalog. Returns true on success.
+// Regular files are memory-mapped and split in place; anything that cannot be
+// mapped (pipes, platforms without mmap) is read line by line instead.
+// Large mapped files are cut at line boundaries and parsed in parallel, then
+// merged in file order so the result matches a sequential load exactly.
+// With options.useSnapshot, a current snapshot replaces the parse entirely.
+inline bool loadCoursesFromFile(const std::string& filename, Catalog& catalog, std::vector<std::string>& warnings,
+                                const LoadOptions& options = LoadOptions()) {
+    LoadMetrics metrics;
+    bool ok = false;
+    {
+        ABCU_SCOPED_TIMER(metrics.totalNs);
+        ok = loadCoursesFromFile(filename, catalog, warnings, options, metrics);
+    }
+    if (ok && options.metrics != nullptr) {
+        *options.metrics = metrics;
+    }
+    return ok;
+}
+
+
+// What changed between two versions of a catalog that share handles
+struct CatalogDiff {
+    bool full = false;              // handles were renumbered: nothing can be carried over
+    std::vector<uint32_t> added;    // defined now, undefined or absent before
+    std::vector<uint32_t> updated;  // defined in both, but title or prereqs differ
+    std::vector<uint32_t> removed;  // defined before, undefined now
+    std::vector<bool> graphChanged; // per course: its prereq list differs
+
+    bool empty() const { return !full && added.empty() && updated.empty() && removed.empty(); }
+};
+
+// Fingerprint of a course's title and of its prereq list. Handles are stable
+// across an incremental reload, so equal edge hashes mean equal edges.
+inline uint64_t titleFingerprint(const Catalog& catalog, uint32_t h) { return hashBytes(catalog.title(h)); }
+
+inline uint64_t prereqFingerprint(const Catalog& catalog, uint32_t h) {
+    HandleRange pre = catalog.prereqs(h);
+    return hashBytes(std::string_view(reinterpret_cast<const char*>(pre.first), pre.size() * sizeof(uint32_t)));
+}
+
+// Reload filename as a new version of current, leaving current untouched so
+// it can keep serving lookups until the caller swaps next in. The new catalog
+// is seeded with current's IDs in handle order, so every surviving course
+// keeps its handle; diff then lists the courses whose fingerprints changed,
+// and the sorted order is patched instead of re-sorted. IDs that disappear
+// stay behind as unreferenced placeholders (never listed or found); once
+// they make up a quarter of the catalog, the reload starts from scratch and
+// reports diff.full. Snapshots are not used on this path.
+inline bool reloadCoursesFromFile(const std::string& filename, const Catalog& current, std::unique_ptr<Catalog>& next,
+                                  std::vector<std::string>& warnings, CatalogDiff& diff, const LoadOptions& options,
+                                  LoadMetrics& metrics) {
+    MappedFile mapped = [&] {
+        ABCU_SCOPED_TIMER(metrics.openNs);
+        return MappedFile(filename);
+    }();
+    metrics.bytes = mapped.valid() ? mapped.view().size() : 0;
+    std::ifstream in;
+    if (!mapped.valid()) {
+        in.open(filename);
+        if (!in) {
+            std::cerr << "Error: Could not open file: " << filename << std::endl;
+            return false;
+        }
+    }
+
+    next = std::make_unique<Catalog>(current.backend());
+    for (uint32_t h = 0; h < current.size(); ++h) {
+        next->intern(current.id(h));
+    }
+    if (!parseCatalogInput(filename, mapped, in, *next, warnings, options, metrics)) {
+        next.reset();
+        return false;
+    }
+    {
+        ABCU_SCOPED_TIMER(metrics.finalizeNs);
+        next->finalize(false);
+    }
+
+    diff = CatalogDiff();
+    const size_t n = next->size();
+    std::vector<bool> referenced(n, false);
+    const CatalogArrays& a = next->arrays();
+    for (uint32_t i = 0; i < a.edgeCount; ++i) {
+        referenced[a.prereqs[i]] = true;
+    }
+    size_t orphans = 0;
+    for (uint32_t h = 0; h < n; ++h) {
+        orphans += (next->definitionLine(h) == 0 && next->prereqs(h).empty() && !referenced[h]) ? 1 : 0;
+    }
+    if (orphans * 4 > n) {
+        // Too much dead weight: renumber without the orphans
+        std::unique_ptr<Catalog> packed = std::make_unique<Catalog>(current.backend());
+        std::vector<uint32_t> newHandle(n, kNoCourse);
+        for (uint32_t h = 0; h < n; ++h) {
+            if (next->definitionLine(h) != 0 || !next->prereqs(h).empty() || referenced[h]) {
+                newHandle[h] = packed->intern(next->id(h));
+                packed->setTitle(newHandle[h], next->title(h));
+                if (next->definitionLine(h) != 0) {
+                    packed->define(newHandle[h], next->definitionLine(h));
+                }
+            }
+        }
+        for (const DuplicateDefinition* d = next->duplicatesBegin(); d != next->duplicatesEnd(); ++d) {
+            packed->define(newHandle[d->course], d->line);
+        }
+        for (uint32_t h = 0; h < n; ++h) {
+            for (uint32_t p : next->prereqs(h)) {
+                packed->addPrereq(newHandle[h], newHandle[p]);
+            }
+        }
+        packed->finalize();
+        if (options.compact) {
+            ABCU_SCOPED_TIMER(metrics.compactNs);
+            packed->compact();
+        }
+        next = std::move(packed);
+        diff.full = true;
+        return true;
+    }
+
+    diff.graphChanged.assign(n, false);
+    for (uint32_t h = 0; h < n; ++h) {
+        bool wasDefined = h < current.size() && !current.title(h).empty();
+        bool isDefined = !next->title(h).empty();
+        bool edgesDiffer = h < current.size() ? prereqFingerprint(current, h) != prereqFingerprint(*next, h)
+                                              : !next->prereqs(h).empty();
+        diff.graphChanged[h] = edgesDiffer;
+        if (isDefined && !wasDefined) {
+            diff.added.push_back(h);
+        } else if (!isDefined && wasDefined) {
+            diff.removed.push_back(h);
+        } else if (isDefined && (edgesDiffer || titleFingerprint(current, h) != titleFingerprint(*next, h))) {
+            diff.updated.push_back(h);
+        }
+    }
+
+    // IDs never change, so the old order minus removals, merged with the sorted additions, is the new order
+    auto byId = [&next](uint32_t x, uint32_t y) { return next->id(x) < next->id(y); };
+    std::vector<uint32_t> kept;
+    kept.reserve(current.sortedOrder().size());
+    for (uint32_t h : current.sortedOrder()) {
+        if (!next->title(h).empty()) {
+            kept.push_back(h);
+        }
+    }
+    std::vector<uint32_t> added = diff.added;
+    std::sort(added.begin(), added.end(), byId);
+    std::vector<uint32_t> order(kept.size() + added.size());
+    std::merge(kept.begin(), kept.end(), added.begin(), added.end(), order.begin(), byId);
+    next->setSortedOrder(std::move(order));
+    if (options.compact) {
+        ABCU_SCOPED_TIMER(metrics.compactNs);
+        next->compact();
+    }
+    return true;
+}
+
+// reloadCoursesFromFile, reporting to options.metrics when set
+inline bool reloadCoursesFromFile(const std::string& filename, const Catalog& current, std::unique_ptr<Catalog>& next,
+                                  std::vector<std::string>& warnings, CatalogDiff& diff,
+                                  const LoadOptions& options = LoadOptions()) {
+    LoadMetrics metrics;
+    bool ok = false;
+    {
+        ABCU_SCOPED_TIMER(metrics.totalNs);
+        ok = reloadCoursesFromFile(filename, current, next, warnings, diff, options, metrics);
+    }
+    if (ok) {
+        ABCU_COUNT(metrics.placeholders, countPlaceholders(*next)); // after any orphan packing
+    }
+    if (ok && options.metrics != nullptr) {
+        *options.metrics = metrics;
+    }
+    return ok;
+}
+
+// Publishes immutable catalog versions to concurrent readers, RCU style.
+// Readers acquire() the current version and use it for as long as they like
+// without further synchronization; load() builds the next version on the
+// side (incrementally when one exists) and swaps it in with one atomic
+// pointer store. A reader never waits on a load, and each old version is
+// freed when the last reader holding it lets go. Loads are serialized.
+class CatalogPublisher {
+public:
+    explicit CatalogPublisher(IndexBackend backend = IndexBackend::FlatHash) : backend_(backend) {}
+
+    // Current version, or null before the first successful load
+    std::shared_ptr<const Catalog> acquire() const {
+#ifdef __cpp_lib_atomic_shared_ptr
+        return current_.load(std::memory_order_acquire);
+#else
+        return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+#endif
+    }
+
+    // Load filename as the next version and publish it. diff describes the
+    // change from the previous version (diff.full on the first load). On
+    // failure the current version stays published.
+    bool load(const std::string& filename, std::vector<std::string>& warnings, CatalogDiff& diff,
+              const LoadOptions& options = LoadOptions()) {
+        std::lock_guard<std::mutex> lock(loading_);
+        std::shared_ptr<const Catalog> current = acquire();
+        std::unique_ptr<Catalog> next;
+        diff = CatalogDiff();
+        if (current) {
+            if (!reloadCoursesFromFile(filename, *current, next, warnings, diff, options)) {
+                return false;
+            }
+        } else {
+            next = std::make_unique<Catalog>(backend_);
+            if (!loadCoursesFromFile(filename, *next, warnings, options)) {
+                return false;
+            }
+            diff.full = true;
+        }
+        publish(std::move(next));
+        return true;
+    }
+
+private:
+    void publish(std::shared_ptr<const Catalog> next) {
+#ifdef __cpp_lib_atomic_shared_ptr
+        current_.store(std::move(next), std::memory_order_release);
+#else
+        std::atomic_store_explicit(&current_, std::move(next), std::memory_order_release);
+#endif
+    }
+
+    IndexBackend backend_;
+    std::mutex loading_;
+#ifdef __cpp_lib_atomic_shared_ptr
+    std::atomic<std::shared_ptr<const Catalog>> current_;
+#else
+    std::shared_ptr<const Catalog> current_; // only touched through std::atomic_load/atomic_store
+#endif
+};
+
+// One campus catalog to load into a named shard
+struct ShardSource {
+    std::string name; // normalized to upper case when loaded
+    std::string filename;
+};
+
+static const size_t kNoShard = SIZE_MAX;
+
+// Several catalogs loaded side by side as named shards, e.g. one per campus.
+// A course is addressed as "SHARD:ID", or by its plain ID, which matches the
+// first shard (in load order) that defines it. Inside a shard's file, a
+// prereq written "SHARD:ID" names a course of another shard; it is interned
+// locally like any other ID and resolved through resolveQualified() when
+// shown. Shards are immutable once loaded and safe to query from any thread.
+class CatalogFederation {
+public:
+    explicit CatalogFederation(IndexBackend backend = IndexBackend::FlatHash) : backend_(backend) {}
+
+    // Load every source on its own thread, replacing what was loaded before.
+    // warnings[i] receives the load warnings of sources[i]. Names must be
+    // non-empty, unique and free of ':'. options.metrics receives the shards'
+    // metrics summed (phases are CPU time across shards, totalNs the wall time
+    // of the whole load), and threads = 0 shares the cores among the shards.
+    bool load(const std::vector<ShardSource>& sources, std::vector<std::vector<std::string>>& warnings,
+              const LoadOptions& options = LoadOptions()) {
+        std::vector<std::string> names;
+        for (const ShardSource& source : sources) {
+            std::string name = toUpper(trimView(source.name));
+            if (name.empty() || name.find(':') != std::string::npos) {
+                std::cerr << "Error: invalid shard name: " << source.name << std::endl;
+                return false;
+            }
+            if (std::find(names.begin(), names.end(), name) != names.end()) {
+                std::cerr << "Error: duplicate shard name: " << name << std::endl;
+                return false;
+            }
+            names.push_back(std::move(name));
+        }
+
+        LoadOptions shardOptions = options;
+        if (shardOptions.threads == 0 && !sources.empty()) {
+            shardOptions.threads =
+                std::max<unsigned>(1, std::max(1u, std::thread::hardware_concurrency()) / static_cast<unsigned>(sources.size()));
+        }
+        std::vector<std::shared_ptr<Catalog>> catalogs(sources.size());
+        std::vector<char> loaded(sources.size(), 0);
+        std::vector<LoadMetrics> shardMetrics(sources.size());
+        warnings.assign(sources.size(), {});
+        auto loadOne = [&](size_t i) {
+            LoadOptions own = shardOptions;
+            own.metrics = &shardMetrics[i];
+            catalogs[i] = std::make_shared<Catalog>(backend_);
+            loaded[i] = loadCoursesFromFile(sources[i].filename, *catalogs[i], warnings[i], own) ? 1 : 0;
+        };
+        LoadMetrics total;
+        {
+            ABCU_SCOPED_TIMER(total.totalNs);
+            std::vector<std::thread> pool;
+            for (size_t i = 1; i < sources.size(); ++i) {
+                pool.emplace_back(loadOne, i);
+            }
+            if (!sources.empty()) {
+                loadOne(0);
+            }
+            for (std::thread& t : pool) {
+                t.join();
+            }
+        }
+        if (std::find(loaded.begin(), loaded.end(), 0) != loaded.end()) {
+            return false;
+        }
+
+        shards_.clear();
+        for (size_t i = 0; i < sources.size(); ++i) {
+            shards_.push_back({std::move(names[i]), std::move(catalogs[i])});
+            total.addShard(shardMetrics[i], i == 0);
+        }
+        if (options.metrics != nullptr) {
+            *options.metrics = total;
+        }
+        return true;
+    }
+
+    size_t size() const { return shards_.size(); }
+    std::string_view name(size_t shard) const { return shards_[shard].name; }
+    const Catalog& catalog(size_t shard) const { return *shards_[shard].catalog; }
+
+    // Shard called name (already normalized), or kNoShard
+    size_t findShard(std::string_view name) const {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (shards_[i].name == name) {
+                return i;
+            }
+        }
+        return kNoShard;
+    }
+
+    // Resolve a normalized "SHARD:ID" to a defined course; false when id has
+    // no shard prefix, names no shard, or the shard does not define the course
+    bool resolveQualified(std::string_view id, size_t& shard, uint32_t& handle) const {
+        size_t colon = id.find(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        shard = findShard(id.substr(0, colon));
+        if (shard == kNoShard) {
+            return false;
+        }
+        handle = catalog(shard).find(id.substr(colon + 1));
+        return handle != kNoCourse && !catalog(shard).title(handle).empty();
+    }
+
+    // Resolve a normalized query: "SHARD:ID" in that shard, otherwise the first
+    // shard that defines the plain ID
+    bool resolve(std::string_view id, size_t& shard, uint32_t& handle) const {
+        size_t colon = id.find(':');
+        if (colon != std::string_view::npos && findShard(id.substr(0, colon)) != kNoShard) {
+            return resolveQualified(id, shard, handle);
+        }
+        for (shard = 0; shard < shards_.size(); ++shard) {
+            handle = catalog(shard).find(id);
+            if (handle != kNoCourse && !catalog(shard).title(handle).empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Visit every defined course of every shard in ID order, as
+    // onCourse(shard, handle): a k-way merge of the shards' sorted orders.
+    // Equal IDs from different shards come out in shard order.
+    template <typename OnCourse>
+    void forEachSorted(OnCourse&& onCourse) const {
+        struct Cursor {
+            size_t shard;
+            const uint32_t* next;
+            const uint32_t* end;
+        };
+        auto later = [this](const Cursor& a, const Cursor& b) {
+            std::string_view x = catalog(a.shard).id(*a.next);
+            std::string_view y = catalog(b.shard).id(*b.next);
+            return x != y ? x > y : a.shard > b.shard;
+        };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            HandleRange order = catalog(i).sortedOrder();
+            if (!order.empty()) {
+                heap.push({i, order.first, order.last});
+            }
+        }
+        while (!heap.empty()) {
+            Cursor c = heap.top();
+            heap.pop();
+            onCourse(c.shard, *c.next);
+            if (++c.next != c.end) {
+                heap.push(c);
+            }
+        }
+    }
+
+private:
+    struct Shard {
+        std::string name;
+        std::shared_ptr<const Catalog> catalog;
+    };
+
+    IndexBackend backend_;
+    std::vector<Shard> shards_;
+};
+
+// Progress of an incremental Tarjan strongly-connected-component search over
+// course handles. Components are numbered in the order they complete, which
+// is reverse topological: every component a course requires finishes first.
+struct ComponentSearch {
+    std::vector<uint32_t> componentOf; // per course: component, or kNoCourse if not reached yet
+    std::vector<uint32_t> index;       // per course: discovery index, or kNoCourse
+    std::vector<uint32_t> low;         // per course: low-link
+    uint32_t nextIndex = 0;
+    uint32_t componentCount = 0;
+
+    // Scratch for findComponents, kept so searching from every root allocates
+    // only as the deepest search grows
+    struct Frame {
+        uint32_t node;
+        uint32_t next; // next prereq to visit
+    };
+    std::vector<Frame> frames;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> members;
+
+    void reset(size_t courseCount) {
+        componentOf.assign(courseCount, kNoCourse);
+        index.assign(courseCount, kNoCourse);
+        low.assign(courseCount, 0);
+        nextIndex = 0;
+        componentCount = 0;
+    }
+};
+
+// Run Tarjan's algorithm (iteratively, so deep chains cannot overflow the
+// stack) from root over courses not yet in a component. For each completed
+// component, calls onComponent(component, members) after componentOf is set
+// for its members.
+template <typename OnComponent>
+void findComponents(const Catalog& catalog, uint32_t root, ComponentSearch& search, OnComponent&& onComponent) {
+    if (search.componentOf[root] != kNoCourse) {
+        return;
+    }
+    std::vector<ComponentSearch::Frame>& frames = search.frames;
+    std::vector<uint32_t>& stack = search.stack;
+    auto visit = [&](uint32_t v) {
+        search.index[v] = search.low[v] = search.nextIndex++;
+        stack.push_back(v);
+        frames.push_back({v, 0});
+    };
+
+    visit(root);
+    while (!frames.empty()) {
+        uint32_t v = frames.back().node;
+        HandleRange pre = catalog.prereqs(v);
+        if (frames.back().next < pre.size()) {
+            uint32_t p = pre.first[frames.back().next++];
+            if (search.index[p] == kNoCourse) {
+                visit(p);
+            } else if (search.componentOf[p] == kNoCourse) {
+                // Visited but unassigned means p is still on the Tarjan stack
+                search.low[v] = std::min(search.low[v], search.index[p]);
+            }
+            continue;
+        }
+
+        frames.pop_back();
+        if (!frames.empty()) {
+            uint32_t parent = frames.back().node;
+            search.low[parent] = std::min(search.low[parent], search.low[v]);
+        }
+        if (search.low[v] == search.index[v]) {
+            uint32_t component = search.componentCount++;
+            std::vector<uint32_t>& members = search.members;
+            members.clear();
+            uint32_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                search.componentOf[w] = component;
+                members.push_back(w);
+            } while (w != v);
+            onComponent(component, members);
+        }
+    }
+}
+
+// True when a component is a prerequisite cycle: several courses, or one
+// course that lists itself
+inline bool isCyclicComponent(const Catalog& catalog, const std::vector<uint32_t>& members) {
+    if (members.size() > 1) {
+        return true;
+    }
+    HandleRange pre = catalog.prereqs(members[0]);
+    return std::find(pre.begin(), pre.end(), members[0]) != pre.end();
+}
+
+// A prerequisite no line ever defines, with the courses that list it
+struct DanglingPrereq {
+    uint32_t prereq;
+    std::vector<uint32_t> requiredBy; // sorted by ID
+};
+
+// A later definition of a course, next to the line that first defined it
+struct DuplicateReport {
+    uint32_t course;
+    uint32_t firstLine;
+    uint32_t line;
+};
+
+// Integrity problems in a finalized catalog, each list in a stable order so
+// nightly runs can be diffed
+struct ValidationReport {
+    std::vector<DanglingPrereq> dangling;      // by prereq ID
+    std::vector<DuplicateReport> duplicates;   // by line
+    std::vector<uint32_t> selfPrereqs;         // courses that list themselves, by ID
+    std::vector<std::vector<uint32_t>> cycles; // components of several courses, members and cycles by ID
+
+    size_t problemCount() const { return dangling.size() + duplicates.size() + selfPrereqs.size() + cycles.size(); }
+    bool clean() const { return problemCount() == 0; }
+};
+
+// Courses per validation worker below which the scan stays on one thread
+static const size_t kMinCoursesPerValidator = 1 << 16;
+
+// Check every course of a finalized catalog for dangling prereqs, duplicate
+// definitions, self-prereqs and prerequisite cycles. The per-course scans run
+// on `threads` workers over contiguous handle shards (0 picks one per core
+// for large catalogs) while Tarjan's search runs on the calling thread; the
+// shards' findings are then merged and sorted.
+inline ValidationReport validateCatalog(const Catalog& catalog, unsigned threads = 0) {
+    struct Shard {
+        std::vector<PrereqEdge> dangling; // course requires an undefined prereq
+        std::vector<uint32_t> selfPrereqs;
+    };
+    const size_t n = catalog.size();
+    size_t workers = threads;
+    if (workers == 0) {
+        workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n / kMinCoursesPerValidator);
+    }
+    workers = std::max<size_t>(workers, 1);
+
+    std::vector<Shard> shards(workers);
+    auto scan = [&catalog, n, workers](size_t shard, Shard& out) {
+        uint32_t end = static_cast<uint32_t>(n * (shard + 1) / workers);
+        for (uint32_t h = static_cast<uint32_t>(n * shard / workers); h < end; ++h) {
+            bool self = false;
+            for (uint32_t p : catalog.prereqs(h)) {
+                self = self || p == h;
+                if (catalog.definitionLine(p) == 0) {
+                    out.dangling.push_back({h, p});
+                }
+            }
+            if (self) {
+                out.selfPrereqs.push_back(h);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; ++i) {
+        pool.emplace_back(scan, i, std::ref(shards[i]));
+    }
+
+    ValidationReport report;
+    {
+        ComponentSearch search;
+        search.reset(n);
+        for (uint32_t h = 0; h < n; ++h) {
+            findComponents(catalog, h, search, [&report](uint32_t, const std::vector<uint32_t>& members) {
+                if (members.size() > 1) {
+                    report.cycles.push_back(members);
+                }
+            });
+        }
+    }
+    scan(0, shards[0]);
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    // ID order through sortedOrder() ranks, so a cycle of many thousands of
+    // courses sorts on integers; unlisted courses fall back to comparing IDs
+    std::vector<uint32_t> rank(n, kNoCourse);
+    HandleRange sorted = catalog.sortedOrder();
+    for (uint32_t i = 0; i < sorted.size(); ++i) {
+        rank[sorted.first[i]] = i;
+    }
+    auto byId = [&catalog, &rank](uint32_t a, uint32_t b) {
+        if (rank[a] != kNoCourse && rank[b] != kNoCourse) {
+            return rank[a] < rank[b];
+        }
+        return catalog.id(a) < catalog.id(b);
+    };
+    std::vector<PrereqEdge> dangling;
+    for (Shard& shard : shards) {
+        dangling.insert(dangling.end(), shard.dangling.begin(), shard.dangling.end());
+        report.selfPrereqs.insert(report.selfPrereqs.end(), shard.selfPrereqs.begin(), shard.selfPrereqs.end());
+    }
+    // Group by handle, which is cheap, and compare IDs only within and across groups
+    std::sort(dangling.begin(), dangling.end(), [](const PrereqEdge& a, const PrereqEdge& b) {
+        return a.prereq != b.prereq ? a.prereq < b.prereq : a.course < b.course;
+    });
+    for (size_t i = 0; i < dangling.size(); ++i) {
+        if (report.dangling.empty() || report.dangling.back().prereq != dangling[i].prereq) {
+            report.dangling.push_back({dangling[i].prereq, {}});
+        }
+        std::vector<uint32_t>& requiredBy = report.dangling.back().requiredBy;
+        if (requiredBy.empty() || requiredBy.back() != dangling[i].course) { // a course may list it twice
+            requiredBy.push_back(dangling[i].course);
+        }
+    }
+    for (DanglingPrereq& d : report.dangling) {
+        std::sort(d.requiredBy.begin(), d.requiredBy.end(), byId);
+    }
+    std::sort(report.dangling.begin(), report.dangling.end(),
+              [&byId](const DanglingPrereq& a, const DanglingPrereq& b) { return byId(a.prereq, b.prereq); });
+    std::sort(report.selfPrereqs.begin(), report.selfPrereqs.end(), byId);
+
+    for (const DuplicateDefinition* d = catalog.duplicatesBegin(); d != catalog.duplicatesEnd(); ++d) {
+        report.duplicates.push_back({d->course, catalog.definitionLine(d->course), d->line});
+    }
+    std::sort(report.duplicates.begin(), report.duplicates.end(),
+              [](const DuplicateReport& a, const DuplicateReport& b) { return a.line < b.line; });
+
+    for (std::vector<uint32_t>& cycle : report.cycles) {
+        std::sort(cycle.begin(), cycle.end(), byId);
+    }
+    std::sort(report.cycles.begin(), report.cycles.end(),
+              [&byId](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) { return byId(a[0], b[0]); });
+    return report;
+}
+
+// Transitive prerequisites over a finalized catalog, memoized per course.
+// Closures come from findComponents: a component's closure is its successors
+// plus their closures, and every course in a component shares one closure.
+// Circular prerequisites show up as cyclic components and are reported via
+// cycleMembers() instead of recursing forever.
+// Each course is solved at most once, so repeated queries are O(1) lookups.
+// Memory grows with the total size of the closures solved so far.
+// Not thread-safe; each thread should own its own PrereqClosure.
+class PrereqClosure {
+public:
+    explicit PrereqClosure(const Catalog& catalog) : catalog_(catalog) { reset(); }
+
+    // Forget everything; call after the catalog is reloaded
+    void reset() {
+        search_.reset(catalog_.size());
+        marks_.assign(catalog_.size(), 0);
+        epoch_ = 0;
+        closures_.clear();
+        members_.clear();
+        cyclic_.clear();
+    }
+
+    // Heap bytes held by the closures built so far and the search state
+    uint64_t memoryBytes() const {
+        uint64_t bytes = vectorBytes(search_.componentOf) + vectorBytes(search_.index) + vectorBytes(search_.low) +
+                         vectorBytes(search_.frames) + vectorBytes(search_.stack) + vectorBytes(search_.members) +
+                         vectorBytes(marks_) + vectorBytes(closures_) + vectorBytes(members_) + cyclic_.capacity() / 8;
+        for (size_t c = 0; c < closures_.size(); ++c) {
+            bytes += vectorBytes(closures_[c]) + vectorBytes(members_[c]);
+        }
+        return bytes;
+    }
+
+    // Start over, keeping every closure of previous (built for an earlier
+    // version of this catalog, with the same handles) that no changed prereq
+    // list can reach. Those components are downward closed, so the search
+    // treats them as finished and only the affected subgraph is re-solved.
+    void carryOver(const PrereqClosure& previous, const std::vector<bool>& graphChanged) {
+        reset();
+        for (size_t c = 0; c < previous.closures_.size(); ++c) {
+            auto changed = [&graphChanged](uint32_t h) { return graphChanged[h]; };
+            const std::vector<uint32_t>& members = previous.members_[c];
+            if (std::any_of(members.begin(), members.end(), changed) ||
+                std::any_of(previous.closures_[c].begin(), previous.closures_[c].end(), changed)) {
+                continue;
+            }
+            uint32_t component = search_.componentCount++;
+            for (uint32_t m : members) {
+                search_.componentOf[m] = component;
+                search_.index[m] = search_.nextIndex++;
+            }
+            closures_.push_back(previous.closures_[c]);
+            members_.push_back(members);
+            cyclic_.push_back(previous.cyclic_[c]);
+        }
+    }
+
+    // Every course that course transitively requires, sorted by handle. A
+    // course on a cycle appears in its own closure.
+    const std::vector<uint32_t>& prerequisites(uint32_t course) {
+        solve(course);
+        return closures_[search_.componentOf[course]];
+    }
+
+    // Courses on the same prerequisite cycle as course (including course), or
+    // an empty list when course is not on a cycle
+    const std::vector<uint32_t>& cycleMembers(uint32_t course) {
+        static const std::vector<uint32_t> kNone;
+        solve(course);
+        uint32_t c = search_.componentOf[course];
+        return cyclic_[c] ? members_[c] : kNone;
+    }
+
+private:
+    void solve(uint32_t root) {
+        findComponents(catalog_, root, search_,
+                       [this](uint32_t component, std::vector<uint32_t>& members) { finishComponent(component, members); });
+    }
+
+    // Compute the closure shared by the members of a just-completed component
+    void finishComponent(uint32_t component, std::vector<uint32_t>& members) {
+        bool cyclic = isCyclicComponent(catalog_, members);
+        std::vector<uint32_t> closure;
+        ++epoch_;
+        auto add = [&](uint32_t h) {
+            if (marks_[h] != epoch_) {
+                marks_[h] = epoch_;
+                closure.push_back(h);
+            }
+        };
+        for (uint32_t m : members) {
+            for (uint32_t p : catalog_.prereqs(m)) {
+                uint32_t pc = search_.componentOf[p];
+                if (pc == component) {
+                    continue;
+                }
+                add(p);
+                for (uint32_t q : closures_[pc]) {
+                    add(q);
+                }
+            }
+        }
+        if (cyclic) {
+            for (uint32_t m : members) {
+                add(m);
+            }
+        }
+        std::sort(closure.begin(), closure.end());
+        std::sort(members.begin(), members.end());
+
+        closures_.push_back(std::move(closure));
+        members_.push_back(std::move(members));
+        cyclic_.push_back(cyclic);
+    }
+
+    const Catalog& catalog_;
+    ComponentSearch search_;
+    std::vector<uint32_t> marks_; // per course: epoch_ when already added to the closure being built
+    uint32_t epoch_ = 0;
+    std::vector<std::vector<uint32_t>> closures_; // per component
+    std::vector<std::vector<uint32_t>> members_;  // per component
+    std::vector<bool> cyclic_;                    // per component
+};
+
+// "Does course A transitively require B" in one bit test. Each prerequisite
+// component gets a packed bitset row of every course it can reach; rows are
+// filled in the order findComponents completes components (reverse
+// topological), so a row is the word-wise OR of already finished rows.
+// Memory is about courses * courses / 8 bytes; check estimateBytes() first.
+class ReachabilityIndex {
+public:
+    // Upper bound on the bytes build() keeps for courseCount courses (one row
+    // per component, at most one component per course)
+    static uint64_t estimateBytes(size_t courseCount) {
+        uint64_t words = (uint64_t(courseCount) + 63) / 64;
+        return uint64_t(courseCount) * words * sizeof(uint64_t) + uint64_t(courseCount) * sizeof(uint32_t);
+    }
+
+    bool built() const { return built_; }
+
+    uint64_t memoryBytes() const { return vectorBytes(rows_) + vectorBytes(rowOf_); }
+
+    void clear() {
+        std::vector<uint64_t>().swap(rows_);
+        std::vector<uint32_t>().swap(rowOf_);
+        words_ = 0;
+        built_ = false;
+    }
+
+    // Two passes, so the rows are allocated once at their exact size and peak
+    // memory stays within estimateBytes() plus the O(n) search state. The
+    // first lists each component's members in the order Tarjan's search
+    // finishes them, which puts every component after the ones it reaches;
+    // the second fills the rows in that order.
+    void build(const Catalog& catalog) {
+        clear();
+        const size_t n = catalog.size();
+        words_ = (n + 63) / 64;
+        ComponentSearch search;
+        search.reset(n);
+        std::vector<uint32_t> members;      // all courses, grouped by component in finish order
+        std::vector<uint32_t> starts(1, 0); // per component + 1: its first entry in members
+        std::vector<bool> cyclic;           // per component
+        members.reserve(n);
+        for (uint32_t root = 0; root < n; ++root) {
+            findComponents(catalog, root, search, [&](uint32_t, const std::vector<uint32_t>& component) {
+                members.insert(members.end(), component.begin(), component.end());
+                starts.push_back(static_cast<uint32_t>(members.size()));
+                cyclic.push_back(isCyclicComponent(catalog, component));
+            });
+        }
+
+        rows_.assign(size_t(search.componentCount) * words_, 0);
+        for (uint32_t component = 0; component < search.componentCount; ++component) {
+            uint64_t* row = &rows_[size_t(component) * words_];
+            for (uint32_t i = starts[component]; i < starts[component + 1]; ++i) {
+                for (uint32_t p : catalog.prereqs(members[i])) {
+                    row[p / 64] |= uint64_t(1) << (p % 64);
+                    uint32_t pc = search.componentOf[p];
+                    if (pc != component) {
+                        orRow(row, &rows_[size_t(pc) * words_]);
+                    }
+                }
+            }
+            // Courses on a cycle reach each other, and themselves
+            if (cyclic[component]) {
+                for (uint32_t i = starts[component]; i < starts[component + 1]; ++i) {
+                    row[members[i] / 64] |= uint64_t(1) << (members[i] % 64);
+                }
+            }
+        }
+        rowOf_.swap(search.componentOf);
+        built_ = true;
+    }
+
+    // True if course transitively requires prereq; build() first
+    bool reaches(uint32_t course, uint32_t prereq) const {
+        const uint64_t* row = &rows_[size_t(rowOf_[course]) * words_];
+        return (row[prereq / 64] >> (prereq % 64)) & 1u;
+    }
+
+private:
+    // Plain word loop so the compiler can vectorize it
+    void orRow(uint64_t* dst, const uint64_t* src) const {
+        for (size_t w = 0; w < words_; ++w) {
+            dst[w] |= src[w];
+        }
+    }
+
+    std::vector<uint64_t> rows_;  // per component: words_ words of reachable-course bits
+    std::vector<uint32_t> rowOf_; // per course: its component's row
+    size_t words_ = 0;
+    bool built_ = false;
+};
+
+// Call onWord with each word of text: runs of ASCII letters and digits,
+// lowercased into word (reused as the caller's buffer)
+template <typename OnWord>
+inline void forEachTitleWord(std::string_view text, std::string& word, OnWord onWord) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        while (pos < text.size() && !std::isalnum(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+        word.clear();
+        while (pos < text.size() && std::isalnum(static_cast<unsigned char>(text[pos]))) {
+            word.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(text[pos]))));
+            ++pos;
+        }
+        if (!word.empty()) {
+            onWord(word);
+        }
+    }
+}
+
+// Inverted index from title words to the courses whose titles use them.
+// A posting is a course's rank in sortedOrder(), so every list, and every
+// intersection of lists, is already in ID order. Lists are cut into blocks of
+// kBlockSize ranks: the block's first rank is kept uncompressed as a skip
+// entry and the rest are varint-coded gaps. Words used by at least one title
+// in kDenseShare also get a bitmap over all ranks, which costs at most about
+// twice their compressed list and answers membership in one bit test.
+// The index belongs to the catalog version it was built from; rebuild it when
+// titles or the course set change.
+class TitleIndex {
+public:
+    static constexpr size_t kBlockSize = 128;
+    static constexpr size_t kDenseShare = 16;
+
+    bool built() const { return built_; }
+
+    // Heap bytes held; the word table's nodes are estimated as a next
+    // pointer and a cached hash ahead of the value
+    uint64_t memoryBytes() const {
+        using Node = std::pair<const std::string, uint32_t>;
+        uint64_t bytes = vectorBytes(lists_) + vectorBytes(heads_) + vectorBytes(bytes_) + vectorBytes(bitmaps_) +
+                         terms_.bucket_count() * sizeof(void*) +
+                         terms_.size() * (sizeof(void*) + sizeof(size_t) + sizeof(Node));
+        for (const auto& term : terms_) {
+            if (term.first.capacity() > std::string().capacity()) {
+                bytes += term.first.capacity() + 1;
+            }
+        }
+        return bytes;
+    }
+
+    void clear() {
+        terms_.clear();
+        std::vector<PostingList>().swap(lists_);
+        std::vector<BlockHead>().swap(heads_);
+        std::vector<uint8_t>().swap(bytes_);
+        std::vector<uint64_t>().swap(bitmaps_);
+        built_ = false;
+    }
+
+    void build(const Catalog& catalog) {
+        clear();
+        HandleRange sorted = catalog.sortedOrder();
+        std::vector<std::pair<uint32_t, uint32_t>> hits; // (term, rank) in rank order
+        std::vector<uint32_t> lastRank;                  // per term, to count repeated words once
+        std::string word;
+        for (uint32_t rank = 0; rank < sorted.size(); ++rank) {
+            forEachTitleWord(catalog.title(sorted.begin()[rank]), word, [&](const std::string& w) {
+                auto found = terms_.try_emplace(w, static_cast<uint32_t>(lastRank.size()));
+                uint32_t term = found.first->second;
+                if (found.second) {
+                    lastRank.push_back(kNoCourse);
+                }
+                if (lastRank[term] != rank) {
+                    lastRank[term] = rank;
+                    hits.emplace_back(term, rank);
+                }
+            });
+        }
+
+        // Group the hits by term; a counting sort keeps each list in rank order
+        std::vector<uint32_t> offsets(lastRank.size() + 1, 0);
+        for (const auto& hit : hits) {
+            ++offsets[hit.first + 1];
+        }
+        for (size_t t = 0; t < lastRank.size(); ++t) {
+            offsets[t + 1] += offsets[t];
+        }
+        std::vector<uint32_t> ranks(hits.size());
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (const auto& hit : hits) {
+            ranks[next[hit.first]++] = hit.second;
+        }
+
+        const size_t words = (sorted.size() + 63) / 64;
+        lists_.resize(lastRank.size());
+        bytes_.reserve(hits.size());
+        for (size_t t = 0; t < lastRank.size(); ++t) {
+            PostingList& list = lists_[t];
+            list.count = offsets[t + 1] - offsets[t];
+            list.firstHead = static_cast<uint32_t>(heads_.size());
+            for (uint32_t i = offsets[t]; i < offsets[t + 1]; ++i) {
+                if ((i - offsets[t]) % kBlockSize == 0) {
+                    heads_.push_back({ranks[i], static_cast<uint32_t>(bytes_.size())});
+                } else {
+                    appendVarint(ranks[i] - ranks[i - 1]);
+                }
+            }
+            if (size_t(list.count) * kDenseShare >= sorted.size()) {
+                list.bitmap = bitmaps_.size();
+                bitmaps_.resize(bitmaps_.size() + words, 0);
+                for (uint32_t i = offsets[t]; i < offsets[t + 1]; ++i) {
+                    bitmaps_[list.bitmap + ranks[i] / 64] |= uint64_t(1) << (ranks[i] % 64);
+                }
+            }
+        }
+        bytes_.shrink_to_fit();
+        built_ = true;
+    }
+
+    // Ranks of the courses whose titles contain every one of words (as
+    // produced by forEachTitleWord), ascending. The shortest list is decoded
+    // and each longer one, shortest first, filters it.
+    std::vector<uint32_t> matchAll(const std::vector<std::string>& words) const {
+        std::vector<uint32_t> ranks;
+        std::vector<uint32_t> terms;
+        for (const std::string& w : words) {
+            auto found = terms_.find(w);
+            if (found == terms_.end()) {
+                return ranks;
+            }
+            terms.push_back(found->second);
+        }
+        if (terms.empty()) {
+            return ranks;
+        }
+        std::sort(terms.begin(), terms.end(),
+                  [this](uint32_t a, uint32_t b) { return lists_[a].count < lists_[b].count; });
+
+        const PostingList& shortest = lists_[terms[0]];
+        ranks.resize(shortest.count);
+        for (size_t b = 0; b * kBlockSize < shortest.count; ++b) {
+            decodeBlock(shortest, b, &ranks[b * kBlockSize]);
+        }
+        for (size_t i = 1; i < terms.size() && !ranks.empty(); ++i) {
+            const PostingList& list = lists_[terms[i]];
+            if (list.bitmap != kNoBitmap) {
+                keepInBitmap(&bitmaps_[list.bitmap], ranks);
+            } else {
+                keepInList(list, ranks);
+            }
+        }
+        return ranks;
+    }
+
+    size_t termCount() const { return lists_.size(); }
+
+private:
+    static constexpr size_t kNoBitmap = std::numeric_limits<size_t>::max();
+    static constexpr size_t kProbe = 8; // ranks compared per step inside a block
+
+    struct PostingList {
+        uint32_t count = 0;         // courses using the word
+        uint32_t firstHead = 0;     // its first entry in heads_
+        size_t bitmap = kNoBitmap;  // its first word in bitmaps_, for dense words
+    };
+    struct BlockHead {
+        uint32_t first;  // first rank of the block
+        uint32_t offset; // where the block's gaps start in bytes_
+    };
+
+    void appendVarint(uint32_t v) {
+        while (v >= 0x80) {
+            bytes_.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        bytes_.push_back(static_cast<uint8_t>(v));
+    }
+
+    // Decode block b of list into out; returns how many ranks it holds
+    size_t decodeBlock(const PostingList& list, size_t b, uint32_t* out) const {
+        const BlockHead& head = heads_[list.firstHead + b];
+        const size_t n = std::min(kBlockSize, list.count - b * kBlockSize);
+        const uint8_t* p = bytes_.data() + head.offset;
+        uint32_t value = head.first;
+        out[0] = value;
+        for (size_t i = 1; i < n; ++i) {
+            uint32_t gap = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t byte = *p++;
+                gap |= uint32_t(byte & 0x7f) << shift;
+                if (byte < 0x80) {
+                    break;
+                }
+            }
+            value += gap;
+            out[i] = value;
+        }
+        return n;
+    }
+
+    static void keepInBitmap(const uint64_t* bits, std::vector<uint32_t>& ranks) {
+        size_t kept = 0;
+        for (uint32_t r : ranks) {
+            ranks[kept] = r;
+            kept += (bits[r / 64] >> (r % 64)) & 1u;
+        }
+        ranks.resize(kept);
+    }
+
+    // Keep the ranks that are in list. Each candidate's block is found by
+    // galloping over the skip entries, so only blocks a candidate can be in
+    // are decoded.
+    void keepInList(const PostingList& list, std::vector<uint32_t>& ranks) const {
+        uint32_t block[kBlockSize + kProbe];
+        const BlockHead* heads = &heads_[list.firstHead];
+        const size_t blockCount = (list.count + kBlockSize - 1) / kBlockSize;
+        size_t current = 0;
+        size_t loaded = blockCount; // none yet
+        size_t pos = 0;
+        size_t kept = 0;
+        for (uint32_t r : ranks) {
+            if (heads[current].first > r) {
+                continue; // before the whole list
+            }
+            // Last block starting at or before r: gallop, then bisect
+            size_t lo = current;
+            size_t step = 1;
+            while (lo + step < blockCount && heads[lo + step].first <= r) {
+                lo += step;
+                step *= 2;
+            }
+            size_t hi = std::min(lo + step, blockCount);
+            while (hi - lo > 1) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (heads[mid].first <= r) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            current = lo;
+            if (current != loaded) {
+                size_t n = decodeBlock(list, current, block);
+                std::fill(block + n, block + n + kProbe, kNoCourse);
+                loaded = current;
+                pos = 0;
+            }
+            // Step over the smaller ranks eight at a time without branching;
+            // the padding stops the count at the end of the block
+            for (;;) {
+                size_t smaller = 0;
+                for (size_t k = 0; k < kProbe; ++k) {
+                    smaller += block[pos + k] < r;
+                }
+                pos += smaller;
+                if (smaller < kProbe) {
+                    break;
+                }
+            }
+            ranks[kept] = r;
+            kept += block[pos] == r;
+        }
+        ranks.resize(kept);
+    }
+
+    std::unordered_map<std::string, uint32_t> terms_; // word -> its list
+    std::vector<PostingList> lists_;
+    std::vector<BlockHead> heads_;
+    std::vector<uint8_t> bytes_;
+    std::vector<uint64_t> bitmaps_;
+    bool built_ = false;
+};
+
+// Options for planSemesters
+struct PlanOptions {
+    size_t maxPerTerm = 4; // courses per term; 0 means no cap
+};
+
+// A term-by-term ordering of the target courses and everything they require
+struct SemesterPlan {
+    std::vector<std::vector<uint32_t>> terms; // courses taken each term, sorted by ID
+    std::vector<uint32_t> blocked;            // on or behind a prerequisite cycle, sorted by ID
+};
+
+// Plan the targets and their transitive prerequisites with Kahn's algorithm:
+// a course becomes available the term after its last prerequisite, and each
+// term takes up to maxPerTerm available courses, longest remaining chain
+// first (then by ID), which keeps the number of terms low. Placeholder
+// courses are scheduled like any other, since they still have to be taken.
+// Reads the catalog only, so any number of plans can run concurrently.
+inline SemesterPlan planSemesters(const Catalog& catalog, const std::vector<uint32_t>& targets, const PlanOptions& options) {
+    // Collect the needed courses and give them dense local numbers
+    std::unordered_map<uint32_t, uint32_t> local;
+    std::vector<uint32_t> courses;
+    std::vector<uint32_t> pending(targets.begin(), targets.end());
+    while (!pending.empty()) {
+        uint32_t c = pending.back();
+        pending.pop_back();
+        if (local.emplace(c, static_cast<uint32_t>(courses.size())).second) {
+            courses.push_back(c);
+            pending.insert(pending.end(), catalog.prereqs(c).begin(), catalog.prereqs(c).end());
+        }
+    }
+
+    // Edges prereq -> dependent, and how many prerequisites each course still waits on
+    const size_t n = courses.size();
+    std::vector<uint32_t> waiting(n, 0);
+    std::vector<std::vector<uint32_t>> dependents(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t p : catalog.prereqs(courses[i])) {
+            dependents[local[p]].push_back(i);
+            ++waiting[i];
+        }
+    }
+
+    // Uncapped Kahn pass for a topological order, then longest chain of dependents per course
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> indegree = waiting;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (indegree[i] == 0) {
+            order.push_back(i);
+        }
+    }
+    for (size_t k = 0; k < order.size(); ++k) {
+        for (uint32_t d : dependents[order[k]]) {
+            if (--indegree[d] == 0) {
+                order.push_back(d);
+            }
+        }
+    }
+    std::vector<uint32_t> height(n, 0);
+    for (size_t k = order.size(); k-- > 0;) {
+        for (uint32_t d : dependents[order[k]]) {
+            height[order[k]] = std::max(height[order[k]], height[d] + 1);
+        }
+    }
+
+    auto later = [&](uint32_t a, uint32_t b) { // priority_queue puts the "largest" first
+        if (height[a] != height[b]) {
+            return height[a] < height[b];
+        }
+        return catalog.id(courses[a]) > catalog.id(courses[b]);
+    };
+    std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(later)> ready(later);
+    for (uint32_t i = 0; i < n; ++i) {
+        if (waiting[i] == 0) {
+            ready.push(i);
+        }
+    }
+
+    SemesterPlan plan;
+    auto byId = [&catalog](uint32_t a, uint32_t b) { return catalog.id(a) < catalog.id(b); };
+    std::vector<bool> scheduled(n, false);
+    while (!ready.empty()) {
+        std::vector<uint32_t> term;
+        while (!ready.empty() && (options.maxPerTerm == 0 || term.size() < options.maxPerTerm)) {
+            term.push_back(ready.top());
+            ready.pop();
+        }
+        // Dependents unlock only after the whole term is done
+        for (uint32_t i : term) {
+            scheduled[i] = true;
+            for (uint32_t d : dependents[i]) {
+                if (--waiting[d] == 0) {
+                    ready.push(d);
+                }
+            }
+        }
+        std::vector<uint32_t> handles;
+        for (uint32_t i : term) {
+            handles.push_back(courses[i]);
+        }
+        std::sort(handles.begin(), handles.end(), byId);
+        plan.terms.push_back(std::move(handles));
+    }
+
+    for (uint32_t i = 0; i < n; ++i) {
+        if (!scheduled[i]) {
+            plan.blocked.push_back(courses[i]);
+        }
+    }
+    std::sort(plan.blocked.begin(), plan.blocked.end(), byId);
+    return plan;
+}
+
+// Plan many target sets over one shared, read-only catalog, one plan at a
+// time per worker thread. Results are in request order.
+inline std::vector<SemesterPlan> planSemestersBatch(const Catalog& catalog,
+                                                    const std::vector<std::vector<uint32_t>>& requests,
+                                                    const PlanOptions& options, unsigned threads = 0) {
+    std::vector<SemesterPlan> plans(requests.size());
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, requests.size()));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < requests.size(); i = next++) {
+            plans[i] = planSemesters(catalog, requests[i], options);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    return plans;
+}
+
+// Resolve a comma- or space-separated list of course IDs (case-insensitive).
+// IDs that are not defined courses are returned in unknown.
+inline std::vector<uint32_t> parseCourseList(const Catalog& catalog, std::string_view list, std::vector<std::string>& unknown) {
+    std::vector<uint32_t> handles;
+    std::string id;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find_first_of(", \t", pos);
+        if (end == std::string_view::npos) {
+            end = list.size();
+        }
+        id.clear();
+        appendUpper(id, trimView(list.substr(pos, end - pos)));
+        pos = end + 1;
+        if (id.empty()) {
+            continue;
+        }
+        uint32_t h = catalog.find(id);
+        if (h == kNoCourse || catalog.title(h).empty()) {
+            unknown.push_back(id);
+        } else if (std::find(handles.begin(), handles.end(), h) == handles.end()) {
+            handles.push_back(h);
+        }
+    }
+    return handles;
+}
+
+// ---------------------------------------------------------------------------
+// Query API: structured results for programs that embed the catalog. Nothing
+// below prints; rendering is up to the caller. IDs are matched the way the
+// loader stores them (trimmed, ASCII uppercase).
+
+// One course as reported by a query; the views point into the catalog
+struct CourseRef {
+    uint32_t handle = kNoCourse;
+    std::string_view id;
+    std::string_view title; // empty for placeholders (referenced but never defined)
+};
+
+inline CourseRef courseRef(const Catalog& catalog, uint32_t handle) {
+    return {handle, catalog.id(handle), catalog.title(handle)};
+}
+
+enum class QueryStatus { Found, EmptyId, NotFound };
+
+// Normalize a raw course ID into query and find it among the defined courses
+inline QueryStatus findDefinedCourse(const Catalog& catalog, std::string_view raw, std::string& query, uint32_t& handle) {
+    query.clear();
+    appendUpper(query, trimView(raw));
+    if (query.empty()) {
+        return QueryStatus::EmptyId;
+    }
+    handle = catalog.find(query);
+    if (handle == kNoCourse || catalog.title(handle).empty()) {
+        return QueryStatus::NotFound;
+    }
+    return QueryStatus::Found;
+}
+
+// Defined courses whose IDs start with prefix (already normalized), in ID
+// order, at most limit of them. sortedOrder() doubles as the prefix index:
+// the matches are one contiguous run, found by binary search, so this costs
+// O(log n + prefix + results) with nothing extra built at load time.
+inline std::vector<CourseRef> completeCourseId(const Catalog& catalog, std::string_view prefix, size_t limit) {
+    std::vector<CourseRef> matches;
+    HandleRange sorted = catalog.sortedOrder();
+    const uint32_t* it = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+        [&catalog](uint32_t h, std::string_view key) { return catalog.id(h) < key; });
+    for (; it != sorted.end() && matches.size() < limit; ++it) {
+        std::string_view id = catalog.id(*it);
+        if (id.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        matches.push_back(courseRef(catalog, *it));
+    }
+    return matches;
+}
+
+// How many "did you mean" candidates a failed lookup offers, and how far off
+// a fuzzy match may be
+constexpr size_t kSuggestionLimit = 5;
+constexpr size_t kSuggestionDistance = 2;
+
+// Defined courses a mistyped or partial ID (already normalized) most likely
+// meant. Partial IDs ("CSCI3") get their completions; otherwise the courses
+// within maxDistance edits (insertions, deletions, substitutions and swaps of
+// adjacent characters), closest first and then by ID.
+//
+// The edit-distance table is filled one ID character per row while walking
+// sortedOrder(), as a depth-first walk of a trie would: rows for the prefix an
+// ID shares with the previous one are reused, and once a prefix is too far
+// from the query every ID under it is skipped with one binary search.
+inline std::vector<CourseRef> suggestCourseIds(const Catalog& catalog, std::string_view query,
+                                               size_t limit = kSuggestionLimit,
+                                               size_t maxDistance = kSuggestionDistance) {
+    std::vector<CourseRef> suggestions = completeCourseId(catalog, query, limit);
+    if (!suggestions.empty() || query.empty()) {
+        return suggestions;
+    }
+    const size_t width = query.size() + 1;
+    std::vector<size_t> table(width);   // row d: distances from the ID's first d characters
+    std::vector<size_t> rowMin(1, 0);   // smallest entry of each row
+    for (size_t j = 0; j < width; ++j) {
+        table[j] = j;
+    }
+    std::vector<std::pair<size_t, uint32_t>> close; // (distance, handle), in ID order
+    std::string_view previous;
+    size_t validRows = 0; // rows 1..validRows hold previous's prefix
+
+    HandleRange sorted = catalog.sortedOrder();
+    const uint32_t* it = sorted.begin();
+    while (it != sorted.end()) {
+        std::string_view id = catalog.id(*it);
+        size_t depth = 0;
+        size_t shared = std::min(validRows, id.size());
+        while (depth < shared && id[depth] == previous[depth]) {
+            ++depth;
+        }
+        size_t pruneAt = 0;
+        for (; depth < id.size(); ++depth) {
+            const size_t d = depth + 1;
+            if (table.size() < (d + 1) * width) {
+                table.resize((d + 1) * width);
+                rowMin.resize(d + 1);
+            }
+            size_t* cur = &table[d * width];
+            const size_t* prev = cur - width;
+            cur[0] = d;
+            size_t lowest = d;
+            for (size_t j = 1; j < width; ++j) {
+                size_t cost = id[depth] == query[j - 1] ? 0 : 1;
+                size_t v = std::min({prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + cost});
+                if (depth > 0 && j > 1 && id[depth] == query[j - 2] && id[depth - 1] == query[j - 1]) {
+                    v = std::min(v, (prev - width)[j - 2] + 1);
+                }
+                cur[j] = v;
+                lowest = std::min(lowest, v);
+            }
+            rowMin[d] = lowest;
+            // Later rows take at least this row's minimum, or one more than the
+            // previous row's (through a swap), so nothing deeper can qualify
+            if (lowest > maxDistance && rowMin[d - 1] >= maxDistance) {
+                pruneAt = d;
+                break;
+            }
+        }
+        previous = id;
+        if (pruneAt != 0) {
+            validRows = pruneAt;
+            std::string_view prefix = id.substr(0, pruneAt);
+            it = std::partition_point(it, sorted.end(),
+                [&catalog, prefix](uint32_t h) { return catalog.id(h).compare(0, prefix.size(), prefix) == 0; });
+            continue;
+        }
+        validRows = id.size();
+        size_t distance = table[id.size() * width + query.size()];
+        if (distance <= maxDistance) {
+            close.emplace_back(distance, *it);
+        }
+        ++it;
+    }
+    std::stable_sort(close.begin(), close.end(),
+        [](const std::pair<size_t, uint32_t>& a, const std::pair<size_t, uint32_t>& b) { return a.first < b.first; });
+    for (size_t i = 0; i < close.size() && i < limit; ++i) {
+        suggestions.push_back(courseRef(catalog, close[i].second));
+    }
+    return suggestions;
+}
+
+// A course and its direct prerequisites
+struct CourseLookup {
+    QueryStatus status = QueryStatus::EmptyId;
+    std::string query; // normalized ID that was looked up
+    CourseRef course;
+    std::vector<CourseRef> prereqs; // in file order
+    std::vector<CourseRef> suggestions; // NotFound only: see suggestCourseIds
+};
+
+inline CourseLookup lookupCourse(const Catalog& catalog, std::string_view raw) {
+    ABCU_SCOPED_TIMER(gQueryMetrics.courseLookupNs);
+    ABCU_COUNT(gQueryMetrics.courseLookups, 1);
+    CourseLookup result;
+    uint32_t handle = kNoCourse;
+    result.status = findDefinedCourse(catalog, raw, result.query, handle);
+    if (result.status == QueryStatus::NotFound) {
+        result.suggestions = suggestCourseIds(catalog, result.query);
+    }
+    if (result.status != QueryStatus::Found) {
+        return result;
+    }
+    result.course = courseRef(catalog, handle);
+    HandleRange prereqs = catalog.prereqs(handle);
+    result.prereqs.reserve(prereqs.size());
+    for (uint32_t pid : prereqs) {
+        result.prereqs.push_back(courseRef(catalog, pid));
+    }
+    return result;
+}
+
+// lookupCourse across a federation. The course's ID stays as its shard
+// writes it; prereqs of the form "SHARD:ID" keep that ID and take their
+// title from the shard that defines them.
+struct FederatedLookup {
+    CourseLookup lookup;
+    size_t shard = kNoShard;
+    std::vector<size_t> suggestionShards; // shard of each lookup.suggestions entry
+};
+
+// suggestCourseIds over every shard ("SHARD:ID" queries: over that shard only).
+// Each shard's candidates are already best first, so they are taken in rounds,
+// one per shard at a time, until there are limit of them.
+inline void suggestFederatedCourseIds(const CatalogFederation& federation, FederatedLookup& result,
+                                      size_t limit = kSuggestionLimit) {
+    std::string_view query = result.lookup.query;
+    size_t only = kNoShard;
+    size_t colon = query.find(':');
+    if (colon != std::string_view::npos) {
+        only = federation.findShard(query.substr(0, colon));
+        if (only != kNoShard) {
+            query.remove_prefix(colon + 1);
+        }
+    }
+    std::vector<std::vector<CourseRef>> perShard(federation.size());
+    for (size_t i = 0; i < federation.size(); ++i) {
+        if (only == kNoShard || only == i) {
+            perShard[i] = suggestCourseIds(federation.catalog(i), query, limit);
+        }
+    }
+    for (size_t rank = 0; rank < limit; ++rank) {
+        for (size_t i = 0; i < perShard.size() && result.lookup.suggestions.size() < limit; ++i) {
+            if (rank < perShard[i].size()) {
+                result.lookup.suggestions.push_back(perShard[i][rank]);
+                result.suggestionShards.push_back(i);
+            }
+        }
+    }
+}
+
+inline FederatedLookup lookupFederatedCourse(const CatalogFederation& federation, std::string_view raw) {
+    ABCU_SCOPED_TIMER(gQueryMetrics.courseLookupNs);
+    ABCU_COUNT(gQueryMetrics.courseLookups, 1);
+    FederatedLookup result;
+    CourseLookup& lookup = result.lookup;
+    appendUpper(lookup.query, trimView(raw));
+    uint32_t handle = kNoCourse;
+    if (lookup.query.empty()) {
+        lookup.status = QueryStatus::EmptyId;
+        return result;
+    }
+    if (!federation.resolve(lookup.query, result.shard, handle)) {
+        lookup.status = QueryStatus::NotFound;
+        result.shard = kNoShard;
+        suggestFederatedCourseIds(federation, result);
+        return result;
+    }
+    lookup.status = QueryStatus::Found;
+    const Catalog& catalog = federation.catalog(result.shard);
+    lookup.course = courseRef(catalog, handle);
+    for (uint32_t pid : catalog.prereqs(handle)) {
+        CourseRef ref = courseRef(catalog, pid);
+        size_t otherShard = kNoShard;
+        uint32_t other = kNoCourse;
+        if (ref.title.empty() && federation.resolveQualified(ref.id, otherShard, other)) {
+            ref.title = federation.catalog(otherShard).title(other);
+        }
+        lookup.prereqs.push_back(ref);
+    }
+    return result;
+}
+
+// Everything a course transitively requires
+struct PrerequisiteChain {
+    QueryStatus status = QueryStatus::EmptyId;
+    std::string query;
+    CourseRef course;
+    std::vector<CourseRef> chain; // sorted by ID
+    // Prerequisite cycles met on the way (including one through course),
+    // each sorted by ID, in chain order of their first member
+    std::vector<std::vector<CourseRef>> cycles;
+};
+
+inline PrerequisiteChain lookupPrerequisiteChain(const Catalog& catalog, PrereqClosure& closure, std::string_view raw) {
+    ABCU_SCOPED_TIMER(gQueryMetrics.chainLookupNs);
+    ABCU_COUNT(gQueryMetrics.chainLookups, 1);
+    PrerequisiteChain result;
+    uint32_t handle = kNoCourse;
+    result.status = findDefinedCourse(catalog, raw, result.query, handle);
+    if (result.status != QueryStatus::Found) {
+        return result;
+    }
+    result.course = courseRef(catalog, handle);
+
+    std::vector<uint32_t> chain = closure.prerequisites(handle);
+    std::sort(chain.begin(), chain.end(), [&catalog](uint32_t a, uint32_t b) { return catalog.id(a) < catalog.id(b); });
+    result.chain.reserve(chain.size());
+    for (uint32_t pid : chain) {
+        result.chain.push_back(courseRef(catalog, pid));
+    }
+
+    // Report each cycle once, identified by its smallest handle
+    std::vector<uint32_t> seen;
+    chain.push_back(handle);
+    for (uint32_t h : chain) {
+        const std::vector<uint32_t>& cycle = closure.cycleMembers(h);
+        if (cycle.empty() || std::find(seen.begin(), seen.end(), cycle.front()) != seen.end()) {
+            continue;
+        }
+        seen.push_back(cycle.front());
+        std::vector<CourseRef> members;
+        for (uint32_t m : cycle) {
+            members.push_back(courseRef(catalog, m));
+        }
+        std::sort(members.begin(), members.end(), [](const CourseRef& a, const CourseRef& b) { return a.id < b.id; });
+        result.cycles.push_back(std::move(members));
+    }
+    return result;
+}
+
+enum class Requirement { None, Direct, Indirect };
+
+// Whether one course (transitively) requires another
+struct RequirementCheck {
+    QueryStatus status = QueryStatus::EmptyId; // NotFound refers to the course; any prereq ID may be asked about
+    std::string course;
+    std::string prereq;
+    Requirement requirement = Requirement::None;
+};
+
+// Uses the reachability index when it has been built, otherwise the memoized closure
+inline RequirementCheck checkRequirement(const Catalog& catalog, PrereqClosure& closure, const ReachabilityIndex& reach,
+                                         std::string_view courseRaw, std::string_view prereqRaw) {
+    ABCU_SCOPED_TIMER(gQueryMetrics.requirementCheckNs);
+    ABCU_COUNT(gQueryMetrics.requirementChecks, 1);
+    RequirementCheck result;
+    result.prereq = toUpper(trimView(prereqRaw));
+    uint32_t course = kNoCourse;
+    result.status = findDefinedCourse(catalog, courseRaw, result.course, course);
+    if (result.prereq.empty()) {
+        result.status = QueryStatus::EmptyId;
+    }
+    if (result.status != QueryStatus::Found) {
+        return result;
+    }
+
+    uint32_t prereq = catalog.find(result.prereq);
+    bool required = false;
+    if (prereq != kNoCourse) {
+        if (reach.built()) {
+            required = reach.reaches(course, prereq);
+        } else {
+            const std::vector<uint32_t>& all = closure.prerequisites(course);
+            required = std::binary_search(all.begin(), all.end(), prereq);
+        }
+    }
+    if (required) {
+        HandleRange direct = catalog.prereqs(course);
+        bool isDirect = std::find(direct.begin(), direct.end(), prereq) != direct.end();
+        result.requirement = isDirect ? Requirement::Direct : Requirement::Indirect;
+    }
+    return result;
+}
+
+// Courses whose titles contain every word of a search
+struct TitleSearch {
+    std::vector<std::string> words; // normalized query words, repeats dropped
+    size_t total = 0;               // courses matching
+    std::vector<CourseRef> matches; // the first limit of them, in ID order
+};
+
+// Words are matched whole and case-insensitively; index must have been built
+// from this catalog. A small limit (a page of results) keeps the cost to the
+// intersection itself when a common word matches much of the catalog.
+inline TitleSearch searchTitles(const Catalog& catalog, const TitleIndex& index, std::string_view queryRaw,
+                                size_t limit = std::numeric_limits<size_t>::max()) {
+    ABCU_SCOPED_TIMER(gQueryMetrics.titleSearchNs);
+    ABCU_COUNT(gQueryMetrics.titleSearches, 1);
+    TitleSearch result;
+    std::string word;
+    forEachTitleWord(queryRaw, word, [&result](const std::string& w) {
+        if (std::find(result.words.begin(), result.words.end(), w) == result.words.end()) {
+            result.words.push_back(w);
+        }
+    });
+    std::vector<uint32_t> ranks = index.matchAll(result.words);
+    HandleRange sorted = catalog.sortedOrder();
+    result.total = ranks.size();
+    result.matches.reserve(std::min(ranks.size(), limit));
+    for (size_t i = 0; i < ranks.size() && i < limit; ++i) {
+        result.matches.push_back(courseRef(catalog, sorted.begin()[ranks[i]]));
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Text rendering: the query results formatted the way the menu shows them
+
+// Collects formatted output in a reusable buffer and writes it to the stream
+// in large blocks instead of flushing line by line. Callers flush() before
+// prompting so interactive output still appears in time.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& out, size_t blockSize = 64 * 1024) : out_(out), blockSize_(blockSize) {
+        buffer_.reserve(blockSize_);
+    }
+
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    OutputBuffer& operator<<(std::string_view s) {
+        buffer_.append(s.data(), s.size());
+        if (buffer_.size() >= blockSize_) {
+            writeBlock();
+        }
+        return *this;
+    }
+
+    OutputBuffer& operator<<(char c) {
+        buffer_.push_back(c);
+        if (buffer_.size() >= blockSize_) {
+            writeBlock();
+        }
+        return *this;
+    }
+
+    // Write everything buffered so far and flush the stream
+    void flush() {
+        writeBlock();
+        out_.flush();
+    }
+
+private:
+    void writeBlock() {
+        if (!buffer_.empty()) {
+            out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+            buffer_.clear(); // keeps capacity for the next block
+        }
+    }
+
+    std::ostream& out_;
+    size_t blockSize_;
+    std::string buffer_;
+};
+
+// Appends to a string with OutputBuffer's operator<<, for formatting into memory
+struct StringOut {
+    std::string& text;
+
+    StringOut& operator<<(std::string_view s) {
+        text.append(s.data(), s.size());
+        return *this;
+    }
+    StringOut& operator<<(char c) {
+        text.push_back(c);
+        return *this;
+    }
+};
+
+// Bounded cache of rendered printCourseInfo output, keyed by course handle,
+// so a popular course costs one ID lookup and a copy. Entries remember the
+// catalog version() they were rendered from: the first lookup or store
+// against a reloaded catalog drops a shard's entries, with nothing to call on
+// reload. Handles spread over independently locked shards, each evicting its
+// least recently used entry when full, so threads seldom wait on each other.
+class CourseInfoCache {
+public:
+    explicit CourseInfoCache(size_t capacity, size_t shardCount = 16)
+        : shards_(std::max<size_t>(1, std::min(shardCount, std::max<size_t>(1, capacity)))) {
+        perShard_ = std::max<size_t>(1, (capacity + shards_.size() - 1) / shards_.size());
+    }
+
+    CourseInfoCache(const CourseInfoCache&) = delete;
+    CourseInfoCache& operator=(const CourseInfoCache&) = delete;
+
+    // Write the cached rendering of handle to out; false on a miss
+    bool lookup(const Catalog& catalog, uint32_t handle, OutputBuffer& out) {
+        Shard& shard = shardOf(handle);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        syncVersion(shard, catalog);
+        auto it = shard.index.find(handle);
+        if (it == shard.index.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        out << it->second->text;
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void store(const Catalog& catalog, uint32_t handle, std::string text) {
+        Shard& shard = shardOf(handle);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        syncVersion(shard, catalog);
+        auto it = shard.index.find(handle);
+        if (it != shard.index.end()) {
+            it->second->text = std::move(text); // another thread got here first
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return;
+        }
+        if (shard.lru.size() >= perShard_) {
+            shard.index.erase(shard.lru.back().handle);
+            shard.lru.pop_back();
+        }
+        shard.lru.push_front(Entry{handle, std::move(text)});
+        shard.index.emplace(handle, shard.lru.begin());
+    }
+
+    void clear() {
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+        }
+    }
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    size_t capacity() const { return perShard_ * shards_.size(); }
+
+    size_t size() {
+        size_t n = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            n += shard.lru.size();
+        }
+        return n;
+    }
+
+    // Bytes of the cached renderings, with an estimate of the list and
+    // hash nodes that hold them
+    uint64_t memoryBytes() {
+        using Slot = std::pair<const uint32_t, std::list<Entry>::iterator>;
+        uint64_t bytes = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            bytes += shard.index.bucket_count() * sizeof(void*) +
+                     shard.lru.size() * (2 * sizeof(void*) + sizeof(Entry)) +
+                     shard.index.size() * (2 * sizeof(void*) + sizeof(Slot));
+            for (const Entry& entry : shard.lru) {
+                bytes += entry.text.capacity() > std::string().capacity() ? entry.text.capacity() + 1 : 0;
+            }
+        }
+        return bytes;
+    }
+
+private:
+    struct Entry {
+        uint32_t handle;
+        std::string text;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        uint64_t version = 0;
+        std::list<Entry> lru; // most recently used first
+        std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+    };
+
+    Shard& shardOf(uint32_t handle) { return shards_[handle % shards_.size()]; }
+
+    static void syncVersion(Shard& shard, const Catalog& catalog) {
+        if (shard.version != catalog.version()) {
+            shard.lru.clear();
+            shard.index.clear();
+            shard.version = catalog.version();
+        }
+    }
+
+    std::vector<Shard> shards_;
+    size_t perShard_ = 1;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+// Title to show for a course; placeholders have none
+inline std::string_view titleOrUnknown(const CourseRef& course) {
+    return course.title.empty() ? std::string_view("Title unknown") : course.title;
+}
+
+// Print the error line for a failed lookup; returns true when the course was found
+inline bool printQueryStatus(QueryStatus status, std::string_view query, OutputBuffer& out) {
+    if (status == QueryStatus::EmptyId) {
+        out << "Error: empty course ID." << '\n';
+    } else if (status == QueryStatus::NotFound) {
+        out << "Course not found: " << query << '\n';
+    }
+    return status == QueryStatus::Found;
+}
+
+// "Did you mean" line under a failed lookup; nothing when there are no candidates
+inline void printSuggestions(const std::vector<CourseRef>& suggestions, OutputBuffer& out) {
+    if (suggestions.empty()) {
+        return;
+    }
+    out << "Did you mean: ";
+    for (size_t i = 0; i < suggestions.size(); ++i) {
+        out << (i == 0 ? "" : ", ") << suggestions[i].id;
+    }
+    out << '?' << '\n';
+}
+
+// Print the full, alphanumeric-sorted list of courses with titles.
+// The order is precomputed at load time, so this is a single pass.
+inline void printSortedCourseList(const Catalog& catalog, OutputBuffer& out) {
+    out << '\n';
+    out << "Computer Science Course List" << '\n';
+    out << "----------------------------" << '\n';
+    for (uint32_t h : catalog.sortedOrder()) {
+        out << catalog.id(h) << ", " << catalog.title(h) << '\n';
+    }
+    out << '\n';
+}
+
+// The block printCourseInfo prints for a found course. Out is OutputBuffer or
+// StringOut, so the cache can keep exactly these bytes.
+template <typename Out>
+inline void formatCourseInfo(const CourseLookup& result, Out& out) {
+    out << '\n';
+    out << result.course.id << ": " << result.course.title << '\n';
+
+    if (result.prereqs.empty()) {
+        out << "Prerequisites: None" << '\n';
+    } else {
+        out << "Prerequisites:" << '\n';
+        for (const CourseRef& p : result.prereqs) {
+            out << "  - " << p.id << ": " << titleOrUnknown(p) << '\n';
+        }
+    }
+    out << '\n';
+}
+
+// Print details for a specific course by ID (case-insensitive). With a
+// cache, a course rendered before is copied out of it instead; failed
+// lookups are never cached.
+inline void printCourseInfo(const Catalog& catalog, std::string_view queryRaw, OutputBuffer& out,
+                            CourseInfoCache* cache = nullptr) {
+    if (cache != nullptr) {
+        std::string query;
+        uint32_t handle = kNoCourse;
+        if (findDefinedCourse(catalog, queryRaw, query, handle) == QueryStatus::Found) {
+            if (cache->lookup(catalog, handle, out)) {
+                return;
+            }
+            std::string text;
+            StringOut textOut{text};
+            formatCourseInfo(lookupCourse(catalog, query), textOut);
+            out << text;
+            cache->store(catalog, handle, std::move(text));
+            return;
+        }
+    }
+
+    CourseLookup result = lookupCourse(catalog, queryRaw);
+    if (!printQueryStatus(result.status, result.query, out)) {
+        printSuggestions(result.suggestions, out);
+        return;
+    }
+    formatCourseInfo(result, out);
+}
+
+// printSortedCourseList over every shard, merged into one ID order; each
+// course is shown as SHARD:ID
+inline void printFederatedCourseList(const CatalogFederation& federation, OutputBuffer& out) {
+    out << '\n';
+    out << "Computer Science Course List" << '\n';
+    out << "----------------------------" << '\n';
+    federation.forEachSorted([&](size_t shard, uint32_t h) {
+        const Catalog& catalog = federation.catalog(shard);
+        out << federation.name(shard) << ':' << catalog.id(h) << ", " << catalog.title(h) << '\n';
+    });
+    out << '\n';
+}
+
+// printCourseInfo across a federation, with the course and any "did you mean"
+// candidates shown as SHARD:ID
+inline void printFederatedCourseInfo(const CatalogFederation& federation, std::string_view queryRaw,
+                                     OutputBuffer& out) {
+    FederatedLookup result = lookupFederatedCourse(federation, queryRaw);
+    if (!printQueryStatus(result.lookup.status, result.lookup.query, out)) {
+        const std::vector<CourseRef>& suggestions = result.lookup.suggestions;
+        for (size_t i = 0; i < suggestions.size(); ++i) {
+            out << (i == 0 ? "Did you mean: " : ", ") << federation.name(result.suggestionShards[i]) << ':'
+                << suggestions[i].id;
+        }
+        if (!suggestions.empty()) {
+            out << '?' << '\n';
+        }
+        return;
+    }
+    std::string id(federation.name(result.shard));
+    id.append(1, ':').append(result.lookup.course.id);
+    result.lookup.course.id = id;
+    formatCourseInfo(result.lookup, out);
+}
+
+// Print every course a course transitively requires (case-insensitive ID),
+// sorted by ID, and any prerequisite cycles found along the way
+inline void printFullPrerequisites(const Catalog& catalog, PrereqClosure& closure, std::string_view queryRaw,
+                                   OutputBuffer& out) {
+    PrerequisiteChain result = lookupPrerequisiteChain(catalog, closure, queryRaw);
+    if (!printQueryStatus(result.status, result.query, out)) {
+        return;
+    }
+
+    out << '\n';
+    out << result.course.id << ": " << result.course.title << '\n';
+    if (result.chain.empty()) {
+        out << "Full prerequisite chain: None" << '\n';
+    } else {
+        out << "Full prerequisite chain (" << std::to_string(result.chain.size()) << " courses):" << '\n';
+        for (const CourseRef& p : result.chain) {
+            out << "  - " << p.id << ": " << titleOrUnknown(p) << '\n';
+        }
+    }
+    for (const std::vector<CourseRef>& cycle : result.cycles) {
+        out << "Warning: circular prerequisites among";
+        for (size_t i = 0; i < cycle.size(); ++i) {
+            out << (i == 0 ? " " : ", ") << cycle[i].id;
+        }
+        out << '\n';
+    }
+    out << '\n';
+}
+
+// Print whether one course (transitively) requires another
+inline void printRequirementCheck(const Catalog& catalog, PrereqClosure& closure, const ReachabilityIndex& reach,
+                                  std::string_view courseRaw, std::string_view prereqRaw, OutputBuffer& out) {
+    RequirementCheck result = checkRequirement(catalog, closure, reach, courseRaw, prereqRaw);
+    if (!printQueryStatus(result.status, result.course, out)) {
+        return;
+    }
+
+    out << '\n';
+    if (result.requirement == Requirement::None) {
+        out << result.course << " does not require " << result.prereq << '\n';
+    } else {
+        out << result.course << " requires " << result.prereq
+            << (result.requirement == Requirement::Direct ? " (direct prerequisite)" : " (through other prerequisites)")
+            << '\n';
+    }
+    out << '\n';
+}
+
+// Print the courses whose titles contain every word of the query
+inline void printTitleSearch(const Catalog& catalog, const TitleIndex& index, std::string_view queryRaw,
+                             OutputBuffer& out) {
+    TitleSearch result = searchTitles(catalog, index, queryRaw);
+    if (result.words.empty()) {
+        out << "Error: enter at least one word to search for." << '\n';
+        return;
+    }
+    std::string words;
+    for (const std::string& w : result.words) {
+        words += (words.empty() ? "" : " ") + w;
+    }
+    if (result.matches.empty()) {
+        out << "No course titles contain: " << words << '\n';
+        return;
+    }
+
+    out << '\n';
+    out << "Courses matching \"" << words << "\" (" << std::to_string(result.total) << ")" << '\n';
+    for (const CourseRef& c : result.matches) {
+        out << c.id << ", " << c.title << '\n';
+    }
+    out << '\n';
+}
+
+// Print a validation report: one section per kind of problem, or a single
+// line when the catalog is clean
+inline void printValidationReport(const Catalog& catalog, const ValidationReport& report, OutputBuffer& out) {
+    if (report.clean()) {
+        out << "Validation passed: no problems found." << '\n';
+        return;
+    }
+    auto ids = [&catalog, &out](const std::vector<uint32_t>& handles) {
+        for (size_t i = 0; i < handles.size(); ++i) {
+            out << (i == 0 ? "" : ", ") << catalog.id(handles[i]);
+        }
+    };
+    out << '\n';
+    out << "Validation found " << std::to_string(report.problemCount()) << " problem(s)" << '\n';
+    if (!report.dangling.empty()) {
+        out << "Undefined prerequisites (" << std::to_string(report.dangling.size()) << "):" << '\n';
+        for (const DanglingPrereq& d : report.dangling) {
+            out << "  " << catalog.id(d.prereq) << ", required by: ";
+            ids(d.requiredBy);
+            out << '\n';
+        }
+    }
+    if (!report.duplicates.empty()) {
+        out << "Duplicate definitions (" << std::to_string(report.duplicates.size()) << "):" << '\n';
+        for (const DuplicateReport& d : report.duplicates) {
+            out << "  " << catalog.id(d.course) << " on line " << std::to_string(d.line) << " (first defined on line "
+                << std::to_string(d.firstLine) << ")" << '\n';
+        }
+    }
+    if (!report.selfPrereqs.empty()) {
+        out << "Courses that require themselves (" << std::to_string(report.selfPrereqs.size()) << "): ";
+        ids(report.selfPrereqs);
+        out << '\n';
+    }
+    if (!report.cycles.empty()) {
+        out << "Prerequisite cycles (" << std::to_string(report.cycles.size()) << "):" << '\n';
+        for (const std::vector<uint32_t>& cycle : report.cycles) {
+            out << "  ";
+            ids(cycle);
+            out << '\n';
+        }
+    }
+    out << '\n';
+}
+
+// Print a semester plan term by term
+inline void printSemesterPlan(const Catalog& catalog, const SemesterPlan& plan, OutputBuffer& out) {
+    out << '\n';
+    if (plan.terms.empty()) {
+        out << "Semester plan: nothing to schedule" << '\n';
+    }
+    for (size_t t = 0; t < plan.terms.size(); ++t) {
+        out << "Term " << std::to_string(t + 1) << ":" << '\n';
+        for (uint32_t h : plan.terms[t]) {
+            out << "  - " << catalog.id(h) << ": " << titleOrUnknown(courseRef(catalog, h)) << '\n';
+        }
+    }
+    if (!plan.blocked.empty()) {
+        out << "Cannot schedule (circular prerequisites):";
+        for (size_t i = 0; i < plan.blocked.size(); ++i) {
+            out << (i == 0 ? " " : ", ") << catalog.id(plan.blocked[i]);
+        }
+        out << '\n';
+    }
+    out << '\n';
+}
+
+// Rate per second, or 0 when nothing was timed
+inline double perSecond(double amount, uint64_t ns) {
+    return ns == 0 ? 0.0 : amount * 1e9 / static_cast<double>(ns);
+}
+
+// Print a load report: throughput, counts and the time spent in each phase
+inline void printLoadMetrics(const LoadMetrics& m, OutputBuffer& out) {
+    char line[256];
+    auto ms = [](uint64_t ns) { return static_cast<double>(ns) / 1e6; };
+    out << "Load metrics" << (m.fromSnapshot ? " (from snapshot):" : ":") << '\n';
+    double megabytes = static_cast<double>(m.bytes) / 1e6;
+    std::snprintf(line, sizeof line, "  %.2f MB in %.3f ms (%.1f MB/s), %llu records (%.0f records/s)\n", megabytes,
+                  ms(m.totalNs), perSecond(megabytes, m.totalNs), static_cast<unsigned long long>(m.records),
+                  perSecond(static_cast<double>(m.records), m.totalNs));
+    out << line;
+    std::snprintf(line, sizeof line, "  %llu placeholders created, %llu warnings (list built in %.3f ms)\n",
+                  static_cast<unsigned long long>(m.placeholders), static_cast<unsigned long long>(m.warnings),
+                  ms(m.warningNs));
+    out << line;
+    std::snprintf(line, sizeof line,
+                  "  ms: open %.3f, split %.3f, normalize %.3f, insert %.3f, merge %.3f, finalize %.3f, compact %.3f, "
+                  "snapshot %.3f\n",
+                  ms(m.openNs), ms(m.splitNs), ms(m.normalizeNs), ms(m.insertNs), ms(m.mergeNs), ms(m.finalizeNs),
+                  ms(m.compactNs), ms(m.snapshotNs));
+    out << line;
+    if (m.decompressedBytes != 0) {
+        std::snprintf(line, sizeof line, "  decompressed to %.2f MB in %.3f ms (overlapping the parse)\n",
+                      static_cast<double>(m.decompressedBytes) / 1e6, ms(m.decompressNs));
+        out << line;
+    }
+}
+
+// A catalog's memory with the derived structures and load warnings a front
+// end keeps beside it; structures it has not built stay zero
+struct MemoryReport {
+    CatalogMemory catalog;
+    uint64_t titleIndexBytes = 0;
+    uint64_t reachabilityBytes = 0;
+    uint64_t closureBytes = 0;
+    uint64_t cacheBytes = 0;
+    uint64_t warningBytes = 0;
+
+    uint64_t total() const {
+        return catalog.total() + titleIndexBytes + reachabilityBytes + closureBytes + cacheBytes + warningBytes;
+    }
+};
+
+// Heap bytes of a warning list
+inline uint64_t warningBytes(const std::vector<std::string>& warnings) {
+    uint64_t bytes = vectorBytes(warnings);
+    for (const std::string& w : warnings) {
+        bytes += w.capacity() > std::string().capacity() ? w.capacity() + 1 : 0;
+    }
+    return bytes;
+}
+
+// Print a memory report, one line per kind of data
+inline void printMemoryReport(const MemoryReport& m, OutputBuffer& out) {
+    char line[160];
+    auto row = [&](const char* name, uint64_t bytes) {
+        std::snprintf(line, sizeof line, "  %-20s %12llu bytes\n", name, static_cast<unsigned long long>(bytes));
+        out << line;
+    };
+    std::snprintf(line, sizeof line, "Memory usage: %.2f MB%s\n", static_cast<double>(m.total()) / 1e6,
+                  m.catalog.mapped ? " (catalog columns mapped from the snapshot)" : "");
+    out << line;
+    row("IDs", m.catalog.idBytes);
+    row("titles", m.catalog.titleBytes);
+    row("prereq edges", m.catalog.edgeBytes);
+    row("sorted order", m.catalog.orderBytes);
+    row("definition lines", m.catalog.definitionBytes);
+    row("ID index", m.catalog.indexBytes);
+    row("replaced titles", m.catalog.deadTextBytes);
+    row("unused capacity", m.catalog.slackBytes);
+    row("title search index", m.titleIndexBytes);
+    row("reachability index", m.reachabilityBytes);
+    row("prereq closures", m.closureBytes);
+    row("course cache", m.cacheBytes);
+    row("load warnings", m.warningBytes);
+    std::snprintf(line, sizeof line, "  %llu placeholders account for %llu bytes of the above\n",
+                  static_cast<unsigned long long>(m.catalog.placeholders),
+                  static_cast<unsigned long long>(m.catalog.placeholderBytes));
+    out << line;
+}
+
+// The load report and the query counters as one JSON object
+inline std::string metricsJson(const LoadMetrics& m, const QueryMetrics& q) {
+    auto field = [](std::string& json, const char* name, uint64_t value) {
+        json += json.size() > 1 ? ", \"" : "\"";
+        json += name;
+        json += "\": ";
+        json += std::to_string(value);
+    };
+    std::string load = "{";
+    field(load, "bytes", m.bytes);
+    field(load, "records", m.records);
+    field(load, "placeholders", m.placeholders);
+    field(load, "warnings", m.warnings);
+    field(load, "open_ns", m.openNs);
+    field(load, "snapshot_ns", m.snapshotNs);
+    field(load, "split_ns", m.splitNs);
+    field(load, "normalize_ns", m.normalizeNs);
+    field(load, "insert_ns", m.insertNs);
+    field(load, "merge_ns", m.mergeNs);
+    field(load, "finalize_ns", m.finalizeNs);
+    field(load, "compact_ns", m.compactNs);
+    field(load, "warning_ns", m.warningNs);
+    field(load, "decompress_ns", m.decompressNs);
+    field(load, "decompressed_bytes", m.decompressedBytes);
+    field(load, "total_ns", m.totalNs);
+    field(load, "bytes_per_sec", static_cast<uint64_t>(perSecond(static_cast<double>(m.bytes), m.totalNs)));
+    field(load, "records_per_sec", static_cast<uint64_t>(perSecond(static_cast<double>(m.records), m.totalNs)));
+    load += m.fromSnapshot ? ", \"from_snapshot\": true}" : ", \"from_snapshot\": false}";
+
+    std::string queries = "{";
+    field(queries, "course_lookups", q.courseLookups.load());
+    field(queries, "course_lookup_ns", q.courseLookupNs.load());
+    field(queries, "chain_lookups", q.chainLookups.load());
+    field(queries, "chain_lookup_ns", q.chainLookupNs.load());
+    field(queries, "requirement_checks", q.requirementChecks.load());
+    field(queries, "requirement_check_ns", q.requirementCheckNs.load());
+    field(queries, "title_searches", q.titleSearches.load());
+    field(queries, "title_search_ns", q.titleSearchNs.load());
+    queries += "}";
+    return "{\"load\": " + load + ", \"queries\": " + queries + "}";
+}
+
+// ---------------------------------------------------------------------------
+// Bulk export: every listed course and its prereq edges in one pass over the
+// sorted order, as JSON, as CSV the loader reads back, or as a Graphviz graph
+
+enum class ExportFormat { Json, Csv, Dot };
+
+// Parse "json", "csv" or "dot"; false for anything else
+inline bool parseExportFormat(std::string_view name, ExportFormat& format) {
+    if (name == "json") {
+        format = ExportFormat::Json;
+    } else if (name == "csv") {
+        format = ExportFormat::Csv;
+    } else if (name == "dot") {
+        format = ExportFormat::Dot;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Courses per export chunk: the unit of parallel formatting and one writev buffer
+static const size_t kExportChunkCourses = 1 << 14;
+
+// Append s as a JSON string. Control bytes are escaped; other bytes pass
+// through, so titles are valid JSON exactly when the input was UTF-8.
+inline void appendJsonString(std::string& out, std::string_view s) {
+    out.push_back('"');
+    size_t run = 0; // start of the bytes not yet copied
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        out.append(s.data() + run, i - run);
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(static_cast<char>(c));
+        } else {
+            char escaped[8];
+            std::snprintf(escaped, sizeof escaped, "\\u%04x", c);
+            out += escaped;
+        }
+        run = i + 1;
+    }
+    out.append(s.data() + run, s.size() - run);
+    out.push_back('"');
+}
+
+// Append s as one CSV field, quoted (with doubled quotes) only when the loader needs it
+inline void appendCsvField(std::string& out, std::string_view s) {
+    const char* end = s.data() + s.size();
+    if (findEither(s.data(), end, ',', '"') == end) {
+        out.append(s.data(), s.size());
+        return;
+    }
+    out.push_back('"');
+    for (char c : s) {
+        if (c == '"') {
+            out.push_back('"');
+        }
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+// Append s to a DOT quoted string, escaping its quotes and backslashes
+inline void appendDotEscaped(std::string& out, std::string_view s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+}
+
+// Text written before the first chunk and after the last
+inline std::string_view exportHeader(ExportFormat format) {
+    switch (format) {
+    case ExportFormat::Json:
+        return "{\"courses\": [";
+    case ExportFormat::Dot:
+        return "digraph catalog {\n";
+    case ExportFormat::Csv:
+        break;
+    }
+    return "";
+}
+
+inline std::string_view exportFooter(ExportFormat format) {
+    switch (format) {
+    case ExportFormat::Json:
+        return "\n]}\n";
+    case ExportFormat::Dot:
+        return "}\n";
+    case ExportFormat::Csv:
+        break;
+    }
+    return "";
+}
+
+// Format the courses at sortedOrder() ranks [first, last) into out, reusing
+// its capacity. JSON objects carry their separator, so chunks concatenate.
+// DOT edges point from prereq to course, in the order courses are taken.
+inline void formatExportChunk(const Catalog& catalog, ExportFormat format, size_t first, size_t last,
+                              std::string& out) {
+    out.clear();
+    HandleRange sorted = catalog.sortedOrder();
+    for (size_t rank = first; rank < last; ++rank) {
+        uint32_t h = sorted.first[rank];
+        std::string_view id = catalog.id(h);
+        switch (format) {
+        case ExportFormat::Json: {
+            out += rank == 0 ? "\n{\"id\": " : ",\n{\"id\": ";
+            appendJsonString(out, id);
+            out += ", \"title\": ";
+            appendJsonString(out, catalog.title(h));
+            out += ", \"prereqs\": [";
+            bool firstPrereq = true;
+            for (uint32_t p : catalog.prereqs(h)) {
+                out += firstPrereq ? "" : ", ";
+                appendJsonString(out, catalog.id(p));
+                firstPrereq = false;
+            }
+            out += "]}";
+            break;
+        }
+        case ExportFormat::Csv:
+            appendCsvField(out, id);
+            out.push_back(',');
+            appendCsvField(out, catalog.title(h));
+            for (uint32_t p : catalog.prereqs(h)) {
+                out.push_back(',');
+                appendCsvField(out, catalog.id(p));
+            }
+            out.push_back('\n');
+            break;
+        case ExportFormat::Dot:
+            out += "  \"";
+            appendDotEscaped(out, id);
+            out += "\" [label=\"";
+            appendDotEscaped(out, id);
+            out += "\\n"; // Graphviz line break
+            appendDotEscaped(out, catalog.title(h));
+            out += "\"];\n";
+            for (uint32_t p : catalog.prereqs(h)) {
+                out += "  \"";
+                appendDotEscaped(out, catalog.id(p));
+                out += "\" -> \"";
+                appendDotEscaped(out, id);
+                out += "\";\n";
+            }
+            break;
+        }
+    }
+}
+
+// Destination of an export: a file, or standard output for an empty path.
+// On POSIX each batch of buffers goes out in writev calls straight from
+// where it was formatted; elsewhere it is written through a stream.
+class ExportSink {
+public:
+    ExportSink() = default;
+    ~ExportSink() { close(); }
+
+    ExportSink(const ExportSink&) = delete;
+    ExportSink& operator=(const ExportSink&) = delete;
+
+    bool open(const std::string& path) {
+#ifdef ABCU_HAVE_POSIX
+        fd_ = path.empty() ? STDOUT_FILENO : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ownsFd_ = !path.empty();
+        if (fd_ < 0) {
+            error_ = errno;
+        }
+        return fd_ >= 0;
+#else
+        if (path.empty()) {
+            out_ = &std::cout;
+        } else {
+            file_.open(path, std::ios::binary | std::ios::trunc);
+            out_ = &file_;
+        }
+        return static_cast<bool>(*out_);
+#endif
+    }
+
+    // Write every piece, in order
+    bool write(const std::vector<std::string_view>& pieces) {
+#ifdef ABCU_HAVE_POSIX
+        iov_.clear();
+        for (std::string_view piece : pieces) {
+            if (!piece.empty()) {
+                iov_.push_back({const_cast<char*>(piece.data()), piece.size()});
+            }
+        }
+        size_t done = 0;
+        while (done < iov_.size()) {
+            int batch = static_cast<int>(std::min<size_t>(iov_.size() - done, kMaxIovecs));
+            ssize_t n = ::writev(fd_, &iov_[done], batch);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                error_ = errno;
+                return false;
+            }
+            // Skip what went out; a short write resumes inside the current piece
+            size_t left = static_cast<size_t>(n);
+            while (done < iov_.size() && left >= iov_[done].iov_len) {
+                left -= iov_[done].iov_len;
+                ++done;
+            }
+            if (left != 0) {
+                iov_[done].iov_base = static_cast<char*>(iov_[done].iov_base) + left;
+                iov_[done].iov_len -= left;
+            }
+        }
+        return true;
+#else
+        for (std::string_view piece : pieces) {
+            out_->write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        }
+        return static_cast<bool>(*out_);
+#endif
+    }
+
+    // Finish the output; a file's close can still report a failed write
+    bool close() {
+#ifdef ABCU_HAVE_POSIX
+        bool ok = true;
+        if (ownsFd_ && fd_ >= 0) {
+            ok = ::close(fd_) == 0;
+            if (!ok) {
+                error_ = errno;
+            }
+        }
+        fd_ = -1;
+        ownsFd_ = false;
+        return ok;
+#else
+        if (out_ == nullptr) {
+            return true;
+        }
+        out_->flush();
+        if (out_ == &file_) {
+            file_.close();
+        }
+        bool ok = static_cast<bool>(*out_);
+        out_ = nullptr;
+        return ok;
+#endif
+    }
+
+    // Description of the last failure
+    std::string error() const { return error_ != 0 ? std::strerror(error_) : "write failed"; }
+
+private:
+#ifdef ABCU_HAVE_POSIX
+#ifdef IOV_MAX
+    static constexpr size_t kMaxIovecs = IOV_MAX;
+#else
+    static constexpr size_t kMaxIovecs = 16; // the POSIX minimum
+#endif
+    int fd_ = -1;
+    bool ownsFd_ = false;
+    std::vector<iovec> iov_;
+#else
+    std::ofstream file_;
+    std::ostream* out_ = nullptr;
+#endif
+    int error_ = 0;
+};
+
+// Export the catalog to path (standard output when empty), in ID order.
+// Chunks of kExportChunkCourses are formatted on `threads` workers (0 picks
+// one per core) a batch at a time, while the calling thread writes the
+// previous batch, so formatting overlaps the writes and memory stays at two
+// batches however large the catalog. Returns false after reporting an error.
+inline bool exportCatalog(const Catalog& catalog, ExportFormat format, const std::string& path,
+                          unsigned threads = 0) {
+    const std::string target = path.empty() ? "standard output" : path;
+    ExportSink sink;
+    if (!sink.open(path)) {
+        std::cerr << "Error: Could not open file: " << target << " (" << sink.error() << ")" << std::endl;
+        return false;
+    }
+
+    const size_t n = catalog.sortedOrder().size();
+    const size_t chunkCount = (n + kExportChunkCourses - 1) / kExportChunkCourses;
+    size_t workers = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::max<size_t>(1, std::min(workers, chunkCount));
+    auto formatChunk = [&catalog, format, n](size_t chunk, std::string& out) {
+        size_t first = chunk * kExportChunkCourses;
+        formatExportChunk(catalog, format, first, std::min(n, first + kExportChunkCourses), out);
+    };
+
+    std::vector<std::string> formatting(workers);
+    std::vector<std::string> writing(workers);
+    size_t pending = 0; // chunks in writing, formatted but not written
+    std::vector<std::string_view> pieces{exportHeader(format)};
+    bool ok = sink.write(pieces);
+    for (size_t next = 0; ok && (next < chunkCount || pending != 0);) {
+        size_t batch = std::min(workers, chunkCount - next);
+        std::vector<std::thread> pool;
+        if (batch == 1 && pending == 0) {
+            formatChunk(next, formatting[0]); // nothing to overlap with
+        } else {
+            for (size_t i = 0; i < batch; ++i) {
+                pool.emplace_back(formatChunk, next + i, std::ref(formatting[i]));
+            }
+        }
+        if (pending != 0) {
+            pieces.assign(writing.begin(), writing.begin() + static_cast<std::ptrdiff_t>(pending));
+            ok = sink.write(pieces);
+        }
+        for (std::thread& t : pool) {
+            t.join();
+        }
+        formatting.swap(writing);
+        pending = batch;
+        next += batch;
+    }
+    pieces.assign(1, exportFooter(format));
+    ok = ok && sink.write(pieces);
+    if (!sink.close() || !ok) {
+        std::cerr << "Error: Could not write " << target << ": " << sink.error() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif // ABCU_CATALOG_H
@@ -1,250 +1,502 @@
 // ABCU CS Advising Assistant
-// - Loads course data from a CSV file (CourseID, Title, Prereq1, Prereq2, ...)
-// - Stores course objects in an in-memory structure
 // - Provides a menu to list all courses (alphanumeric) and to show a course with prerequisites
 // - Includes input validation and helpful error messages
 // - Industry-style comments and clear naming for readability
+// - Course storage, loading, queries and rendering live in catalog.h
+// - Listings are written in large buffered blocks, flushed only at menu prompts
+// - Batch mode (--batch CATALOG.csv) answers a stream of course IDs without the menu
+// - --snapshot keeps a binary CATALOG.csv.snap that later loads map in place
+// - --index=map looks course IDs up in a std::map instead of the flat hash index
+// - Tab- and pipe-delimited files are detected automatically (or forced with --delimiter)
+// - Option 4 prints the full transitive prerequisite chain and flags cycles
+// - Option 5 answers "does A require B" from a bitset reachability index
+// - Option 6 (and --plans in batch mode) builds term-by-term semester plans
+// - Option 7 finds courses whose titles contain every word entered
+// - Option 8 (and --validate CATALOG.csv) checks the catalog for data problems
+// - Reloading a file reports which courses were added, updated or removed
+// - --export CATALOG.csv writes all courses and prereq edges as JSON, CSV or DOT (--export-format)
+// - --memory prints a memory breakdown after each load (catalog arrays, indexes, warnings)
+// - --shard NAME=FILE (repeatable) loads one catalog per campus in parallel and answers
+//   "NAME:ID" or plain IDs across all of them; --list prints the merged course list
+// - Server mode (--serve CATALOG.csv) answers queries over TCP; see server.h
+// - Built with -DABCU_ENABLE_METRICS, loads print a phase-by-phase report (--metrics-json saves it)
+// - Built with -DABCU_ENABLE_ZLIB -lz and/or -DABCU_ENABLE_ZSTD -lzstd, .gz and .zst catalogs load directly
+//
+// Build: g++ -std=c++17 -O2 -pthread final.cpp -o advising
+
+#include "catalog.h"
+#include "server.h"
 
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
-#include <map>
-#include <set>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
-struct Course {
-    std::string id;
-    std::string title;
-    std::vector<std::string> prereqs; // prerequisite course IDs
-};
+// Largest reachability index the menu builds on its own unless --reach-budget
+// says otherwise; bigger catalogs answer option 5 from the memoized closures.
+// 512 MiB covers about 65k courses (50k need 313 MB).
+static const uint64_t kDefaultReachabilityBudgetMB = 512;
 
-// Trim leading and trailing whitespace
-static std::string trim(const std::string& s) {
-    size_t start = 0;
-    while (start < s.size() && std::isspace(static_cast<unsigned char>(s[start]))) {
-        start++;
+// Batch planning: each line of in lists one student's target courses.
+// Plans run in parallel and are printed in input order.
+void runBatchPlans(const Catalog& catalog, std::istream& in, const PlanOptions& options, OutputBuffer& out) {
+    std::vector<std::vector<uint32_t>> requests;
+    std::vector<std::vector<std::string>> unknown;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (trimView(line).empty()) {
+            continue;
+        }
+        unknown.emplace_back();
+        requests.push_back(parseCourseList(catalog, line, unknown.back()));
     }
-    size_t end = s.size();
-    while (end > start && std::isspace(static_cast<unsigned char>(s[end - 1]))) {
-        end--;
+
+    std::vector<SemesterPlan> plans = planSemestersBatch(catalog, requests, options);
+    for (size_t i = 0; i < plans.size(); ++i) {
+        out << "Plan " << std::to_string(i + 1) << '\n';
+        for (const std::string& id : unknown[i]) {
+            out << "Course not found: " << id << '\n';
+        }
+        printSemesterPlan(catalog, plans[i], out);
     }
-    return s.substr(start, end - start);
 }
 
-// Uppercase a string (ASCII)
-static std::string toUpper(const std::string& s) {
-    std::string t = s;
-    for (char& c : t) {
-        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+// Read a line safely from std::cin into s; return false on EOF
+bool safeGetline(std::string& s) {
+    if (!std::getline(std::cin, s)) {
+        return false;
+    }
+    // Trim carriage return if present (Windows CRLF handling)
+    if (!s.empty() && s.back() == '\r') {
+        s.pop_back();
     }
-    return t;
+    return true;
 }
 
-// Basic CSV line parser supporting quotes around fields with commas
-static std::vector<std::string> parseCSVLine(const std::string& line) {
-    std::vector<std::string> fields;
-    std::string field;
-    bool inQuotes = false;
-
-    for (size_t i = 0; i < line.size(); ++i) {
-        char ch = line[i];
-        if (inQuotes) {
-            if (ch == '"') {
-                // If this is a doubled quote, append one and continue inside quotes
-                if (i + 1 < line.size() && line[i + 1] == '"') {
-                    field.push_back('"');
-                    ++i;
-                } else {
-                    inQuotes = false;
-                }
-            } else {
-                field.push_back(ch);
-            }
-        } else {
-            if (ch == '"') {
-                inQuotes = true;
-            } else if (ch == ',') {
-                fields.push_back(field);
-                field.clear();
-            } else {
-                field.push_back(ch);
-            }
-        }
-    }
-    fields.push_back(field);
+// Display the main menu, flushing it and everything before it so the
+// previous command's output shows up ahead of the prompt
+void showMenu(OutputBuffer& out) {
+    out << '\n';
+    out << "Welcome to the ABCU Computer Science Advising Assistant" << '\n';
+    out << "--------------------------------------------------------" << '\n';
+    out << "  1. Load Data Structure" << '\n';
+    out << "  2. Print Course List" << '\n';
+    out << "  3. Print Course" << '\n';
+    out << "  4. Print Full Prerequisite Chain" << '\n';
+    out << "  5. Check Whether a Course Requires Another" << '\n';
+    out << "  6. Plan Semesters" << '\n';
+    out << "  7. Search Course Titles" << '\n';
+    out << "  8. Check Catalog Integrity" << '\n';
+    out << "  9. Exit" << '\n';
+    out << '\n';
+    out << "What would you like to do? " << '\n';
+    out.flush();
+}
 
-    // Trim spaces around each field
-    for (std::string& f : fields) {
-        f = trim(f);
-    }
+// Show a prompt, and everything queued before it, ahead of reading the answer
+void prompt(OutputBuffer& out, std::string_view text) {
+    out << text << '\n';
+    out.flush();
+}
 
-    return fields;
+// Print command-line usage to std::cerr
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--index=hash|--index=map] [--snapshot] [--term-cap N]"
+              << " [--delimiter=auto|comma|tab|pipe] [--no-trim] [--keep-id-case] [--memory] [--reach-budget MB]"
+              << " [--batch CATALOG.csv [--queries FILE | --plans FILE]]"
+              << " [--serve CATALOG.csv [--port N] [--bind ADDR] [--workers N] [--cache-entries N]]"
+              << " [--validate CATALOG.csv] [--shard NAME=CATALOG.csv ... [--list] [--queries FILE]]"
+              << " [--export CATALOG.csv [--export-format json|csv|dot] [--output FILE]]" << std::endl;
+    std::cerr << "  --snapshot reuse CATALOG.csv.snap when it matches the CSV; rewrite it after parsing" << std::endl;
+    std::cerr << "  --delimiter  field separator of catalog files (default auto: detected from the first lines);"
+              << " tab and pipe files have no quoting" << std::endl;
+    std::cerr << "  --no-trim  keep whitespace around fields; --keep-id-case: IDs are already upper case"
+              << std::endl;
+    std::cerr << "  --memory   after each load, print how many bytes the catalog, its indexes and the warnings use"
+              << std::endl;
+    std::cerr << "  --reach-budget  largest bitset index option 5 builds, in MiB (default "
+              << kDefaultReachabilityBudgetMB << ", 0 = always use the closures)" << std::endl;
+    std::cerr << "  --batch    load CATALOG.csv, then answer one course ID per line from stdin" << std::endl;
+    std::cerr << "             (or the --queries file) without the interactive menu" << std::endl;
+    std::cerr << "  --plans    with --batch: plan semesters for each line of target course IDs in FILE" << std::endl;
+    std::cerr << "  --term-cap maximum courses per term when planning (default 4, 0 = no cap)" << std::endl;
+    std::cerr << "  --serve    load CATALOG.csv and answer COURSE, CHAIN and LIST requests over TCP"
+              << " (default 127.0.0.1:7070) until interrupted; SIGHUP reloads the file" << std::endl;
+    std::cerr << "  --cache-entries  with --serve: rendered course answers to cache (default 4096, 0 = off)"
+              << std::endl;
+    std::cerr << "  --validate load CATALOG.csv and report undefined prereqs, duplicate lines and cycles;"
+              << " exits 2 when it finds any" << std::endl;
+    std::cerr << "  --shard    load CATALOG.csv as shard NAME (repeat for each campus; loads run in parallel),"
+              << " then answer NAME:ID or plain course IDs from stdin or the --queries file" << std::endl;
+    std::cerr << "  --list     with --shard: print the course list of all shards merged in ID order"
+              << " instead of reading stdin (--queries still runs afterwards)" << std::endl;
+    std::cerr << "  --export   load CATALOG.csv and write every course with its prereqs, in ID order, to the"
+              << " --output file (default stdout); --export-format picks JSON (default), loader-ready CSV,"
+              << " or a Graphviz DOT graph" << std::endl;
+    std::cerr << "  --metrics-json FILE  write load and query metrics as JSON on exit"
+              << " (builds with -DABCU_ENABLE_METRICS)" << std::endl;
 }
 
-// Load courses from a CSV file into the provided map. Returns true on success.
-bool loadCoursesFromFile(const std::string& filename, std::map<std::string, Course>& courses, std::vector<std::string>& warnings) {
-    std::ifstream in(filename);
-    if (!in) {
-        std::cerr << "Error: Could not open file: " << filename << std::endl;
+// Write the metrics JSON for --metrics-json; complains on stderr if it cannot
+bool writeMetricsFile(const std::string& path, const LoadMetrics& load) {
+    std::ofstream file(path);
+    file << metricsJson(load, gQueryMetrics) << '\n';
+    if (!file) {
+        std::cerr << "Error: Could not write metrics to " << path << std::endl;
         return false;
     }
+    return true;
+}
 
-    courses.clear();
-    warnings.clear();
+// --memory outside the menu: a loaded catalog and its warning list, on stream
+void reportMemory(const Catalog& catalog, const std::vector<std::string>& warnings, std::ostream& stream) {
+    MemoryReport memory;
+    memory.catalog = catalog.memoryUsage();
+    memory.warningBytes = warningBytes(warnings);
+    OutputBuffer report(stream);
+    printMemoryReport(memory, report);
+}
 
-    std::string line;
-    size_t lineNum = 0;
-    while (std::getline(in, line)) {
-        ++lineNum;
-        // Skip empty lines
-        std::string trimmed = trim(line);
-        if (trimmed.empty()) {
-            continue;
-        }
+// Load path into catalogs for a command outside the menu. Warnings, the
+// --memory breakdown and (in metrics builds) the load report go to stderr so
+// stdout carries only the command's own output; the warning text is freed
+// once printed. diff, when given, receives what changed. False if the load failed.
+bool loadForCommand(CatalogPublisher& catalogs, const std::string& path, const LoadOptions& options,
+                    bool memoryReport, CatalogDiff* diff = nullptr) {
+    std::vector<std::string> warnings;
+    CatalogDiff changes;
+    if (!catalogs.load(path, warnings, diff != nullptr ? *diff : changes, options)) {
+        return false;
+    }
+    for (const std::string& w : warnings) {
+        std::cerr << "Warning: " << w << '\n';
+    }
+#ifdef ABCU_ENABLE_METRICS
+    if (options.metrics != nullptr) {
+        OutputBuffer report(std::cerr);
+        printLoadMetrics(*options.metrics, report);
+    }
+#endif
+    if (memoryReport) {
+        reportMemory(*catalogs.acquire(), warnings, std::cerr);
+    }
+    // Printed once and never read again; give the text back before the command runs
+    std::vector<std::string>().swap(warnings);
+    return true;
+}
 
-        std::vector<std::string> fields = parseCSVLine(line);
-        if (fields.size() < 2) {
-            warnings.push_back("Line " + std::to_string(lineNum) + " skipped: fewer than 2 fields");
+// Federated batch mode: like runBatchQueries, with IDs resolved across shards
+void runFederatedQueries(const CatalogFederation& federation, std::istream& in, OutputBuffer& out) {
+    std::string query;
+    while (std::getline(in, query)) {
+        if (trimView(query).empty()) {
             continue;
         }
+        printFederatedCourseInfo(federation, query, out);
+    }
+}
 
-        std::string rawId = trim(fields[0]);
-        std::string id = toUpper(rawId);
-        std::string title = fields[1]; // Keep original case for title
-
-        if (id.empty()) {
-            warnings.push_back("Line " + std::to_string(lineNum) + " skipped: empty course ID");
+// Batch mode: answer each course ID read from in, one per line, exactly as
+// option 3 would, with no menu or prompts. Blank lines are ignored.
+void runBatchQueries(const Catalog& catalog, std::istream& in, OutputBuffer& out) {
+    std::string query;
+    while (std::getline(in, query)) {
+        if (trimView(query).empty()) {
             continue;
         }
-        if (title.empty()) {
-            warnings.push_back("Line " + std::to_string(lineNum) + " has empty title for course " + id);
-        }
-
-        // Ensure a Course object exists for this ID
-        Course& course = courses[id];
-        course.id = id;
-        if (!title.empty()) {
-            course.title = title;
-        }
+        printCourseInfo(catalog, query, out);
+    }
+}
 
-        // Handle prerequisites (fields[2..])
-        for (size_t i = 2; i < fields.size(); ++i) {
-            std::string prereqId = toUpper(trim(fields[i]));
-            if (prereqId.empty()) {
-                continue;
+int main(int argc, char* argv[]) {
+    IndexBackend backend = IndexBackend::FlatHash;
+    LoadOptions loadOptions;
+    std::string batchCatalog;
+    std::string batchQueries;
+    std::string batchPlans;
+    PlanOptions planOptions;
+    std::string serveCatalog;
+    std::string validateCatalogFile;
+    std::vector<ShardSource> shards;
+    bool listShards = false;
+    bool memoryReport = false;
+    uint64_t reachBudgetBytes = kDefaultReachabilityBudgetMB << 20;
+    std::string exportCatalogFile;
+    std::string exportPath;
+    ExportFormat exportFormat = ExportFormat::Json;
+    ServerOptions serverOptions;
+    std::string metricsPath;
+    LoadMetrics lastLoad;
+    loadOptions.metrics = &lastLoad;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--index=map") {
+            backend = IndexBackend::Ordered;
+        } else if (arg == "--index=hash") {
+            backend = IndexBackend::FlatHash;
+        } else if (arg == "--snapshot") {
+            loadOptions.useSnapshot = true;
+        } else if (arg == "--delimiter=auto") {
+            loadOptions.format.delimiter = FieldDelimiter::Auto;
+        } else if (arg == "--delimiter=comma") {
+            loadOptions.format.delimiter = FieldDelimiter::Comma;
+        } else if (arg == "--delimiter=tab") {
+            loadOptions.format.delimiter = FieldDelimiter::Tab;
+        } else if (arg == "--delimiter=pipe") {
+            loadOptions.format.delimiter = FieldDelimiter::Pipe;
+        } else if (arg == "--no-trim") {
+            loadOptions.format.trim = false;
+        } else if (arg == "--keep-id-case") {
+            loadOptions.format.upperIds = false;
+        } else if (arg == "--memory") {
+            memoryReport = true;
+        } else if (arg == "--reach-budget" && i + 1 < argc) {
+            reachBudgetBytes = uint64_t(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchCatalog = argv[++i];
+        } else if (arg == "--queries" && i + 1 < argc) {
+            batchQueries = argv[++i];
+        } else if (arg == "--plans" && i + 1 < argc) {
+            batchPlans = argv[++i];
+        } else if (arg == "--term-cap" && i + 1 < argc) {
+            planOptions.maxPerTerm = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveCatalog = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            serverOptions.port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--bind" && i + 1 < argc) {
+            serverOptions.bind = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            serverOptions.workers = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--cache-entries" && i + 1 < argc) {
+            serverOptions.cacheEntries = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--validate" && i + 1 < argc) {
+            validateCatalogFile = argv[++i];
+        } else if (arg == "--shard" && i + 1 < argc) {
+            std::string spec = argv[++i];
+            size_t eq = spec.find('=');
+            if (eq == std::string::npos) {
+                std::cerr << "Error: --shard expects NAME=CATALOG.csv, got " << spec << std::endl;
+                return 1;
             }
-            course.prereqs.push_back(prereqId);
-            // Ensure placeholder exists for prereq so we can resolve title later if defined elsewhere
-            if (courses.find(prereqId) == courses.end()) {
-                Course placeholder;
-                placeholder.id = prereqId;
-                placeholder.title = ""; // unknown title until defined
-                courses[prereqId] = placeholder;
+            shards.push_back({spec.substr(0, eq), spec.substr(eq + 1)});
+        } else if (arg == "--list") {
+            listShards = true;
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportCatalogFile = argv[++i];
+        } else if (arg == "--export-format" && i + 1 < argc) {
+            if (!parseExportFormat(argv[++i], exportFormat)) {
+                std::cerr << "Error: --export-format expects json, csv or dot, got " << argv[i] << std::endl;
+                return 1;
             }
+        } else if (arg == "--output" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--metrics-json" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
         }
     }
+    if ((!batchQueries.empty() || !batchPlans.empty()) && batchCatalog.empty() && shards.empty()) {
+        std::cerr << "Error: --queries and --plans require --batch" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!shards.empty() &&
+        (!batchCatalog.empty() || !serveCatalog.empty() || !validateCatalogFile.empty() || !batchPlans.empty())) {
+        std::cerr << "Error: --shard cannot be combined with --batch, --serve, --validate or --plans" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (listShards && shards.empty()) {
+        std::cerr << "Error: --list requires --shard" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!serveCatalog.empty() && !batchCatalog.empty()) {
+        std::cerr << "Error: --serve and --batch cannot be combined" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!validateCatalogFile.empty() && (!batchCatalog.empty() || !serveCatalog.empty())) {
+        std::cerr << "Error: --validate cannot be combined with --batch or --serve" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!exportCatalogFile.empty() &&
+        (!batchCatalog.empty() || !serveCatalog.empty() || !validateCatalogFile.empty() || !shards.empty())) {
+        std::cerr << "Error: --export cannot be combined with --batch, --serve, --validate or --shard" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!exportPath.empty() && exportCatalogFile.empty()) {
+        std::cerr << "Error: --output requires --export" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+#ifndef ABCU_ENABLE_METRICS
+    if (!metricsPath.empty()) {
+        std::cerr << "Error: --metrics-json needs a build with -DABCU_ENABLE_METRICS" << std::endl;
+        return 1;
+    }
+#endif
 
-    return true;
-}
+#ifdef ABCU_HAVE_POSIX
+    // Nobody is watching a pipe or file line by line; let iostreams skip stdio syncing
+    if (!::isatty(fileno(stdout))) {
+        std::ios::sync_with_stdio(false);
+    }
+#endif
+    OutputBuffer out(std::cout);
+
+    CatalogPublisher catalogs(backend);
 
-// Print the full, alphanumeric-sorted list of courses with titles.
-void printSortedCourseList(const std::map<std::string, Course>& courses) {
-    std::vector<std::string> ids;
-    ids.reserve(courses.size());
-    for (const auto& kv : courses) {
-        const Course& c = kv.second;
-        if (!c.title.empty()) { // Skip placeholder-only entries
-            ids.push_back(c.id);
+    if (!batchCatalog.empty()) {
+        if (!loadForCommand(catalogs, batchCatalog, loadOptions, memoryReport)) {
+            return 1;
+        }
+        std::shared_ptr<const Catalog> catalog = catalogs.acquire();
+        if (!batchPlans.empty()) {
+            std::ifstream plans(batchPlans);
+            if (!plans) {
+                std::cerr << "Error: Could not open file: " << batchPlans << std::endl;
+                return 1;
+            }
+            runBatchPlans(*catalog, plans, planOptions, out);
+        } else if (batchQueries.empty()) {
+            runBatchQueries(*catalog, std::cin, out);
+        } else {
+            std::ifstream queries(batchQueries);
+            if (!queries) {
+                std::cerr << "Error: Could not open file: " << batchQueries << std::endl;
+                return 1;
+            }
+            runBatchQueries(*catalog, queries, out);
         }
+        out.flush();
+        return metricsPath.empty() || writeMetricsFile(metricsPath, lastLoad) ? 0 : 1;
     }
-    std::sort(ids.begin(), ids.end());
 
-    std::cout << std::endl;
-    std::cout << "Computer Science Course List" << std::endl;
-    std::cout << "----------------------------" << std::endl;
-    for (const std::string& id : ids) {
-        const Course& c = courses.at(id);
-        std::cout << id << ", " << c.title << std::endl;
+    if (!shards.empty()) {
+        CatalogFederation federation(backend);
+        std::vector<std::vector<std::string>> warnings;
+        if (!federation.load(shards, warnings, loadOptions)) {
+            return 1;
+        }
+        for (size_t i = 0; i < warnings.size(); ++i) {
+            for (const std::string& w : warnings[i]) {
+                std::cerr << "Warning: " << federation.name(i) << ": " << w << '\n';
+            }
+            if (memoryReport) {
+                std::cerr << "Shard " << federation.name(i) << ":" << std::endl;
+                reportMemory(federation.catalog(i), warnings[i], std::cerr);
+            }
+        }
+#ifdef ABCU_ENABLE_METRICS
+        {
+            OutputBuffer report(std::cerr);
+            printLoadMetrics(lastLoad, report);
+        }
+#endif
+        std::vector<std::vector<std::string>>().swap(warnings);
+        if (listShards) {
+            printFederatedCourseList(federation, out);
+        }
+        if (batchQueries.empty()) {
+            if (!listShards) {
+                runFederatedQueries(federation, std::cin, out);
+            }
+        } else {
+            std::ifstream queries(batchQueries);
+            if (!queries) {
+                std::cerr << "Error: Could not open file: " << batchQueries << std::endl;
+                return 1;
+            }
+            runFederatedQueries(federation, queries, out);
+        }
+        out.flush();
+        return metricsPath.empty() || writeMetricsFile(metricsPath, lastLoad) ? 0 : 1;
     }
-    std::cout << std::endl;
-}
 
-// Print details for a specific course by ID (case-insensitive)
-void printCourseInfo(const std::map<std::string, Course>& courses, const std::string& queryRaw) {
-    std::string query = toUpper(trim(queryRaw));
-    if (query.empty()) {
-        std::cout << "Error: empty course ID." << std::endl;
-        return;
+    if (!validateCatalogFile.empty()) {
+        if (!loadForCommand(catalogs, validateCatalogFile, loadOptions, memoryReport)) {
+            return 1;
+        }
+        ValidationReport report = validateCatalog(*catalogs.acquire());
+        printValidationReport(*catalogs.acquire(), report, out);
+        out.flush();
+        if (!metricsPath.empty() && !writeMetricsFile(metricsPath, lastLoad)) {
+            return 1;
+        }
+        return report.clean() ? 0 : 2;
     }
 
-    auto it = courses.find(query);
-    if (it == courses.end() || it->second.title.empty()) {
-        std::cout << "Course not found: " << query << std::endl;
-        return;
+    if (!exportCatalogFile.empty()) {
+        if (!loadForCommand(catalogs, exportCatalogFile, loadOptions, memoryReport)) {
+            return 1;
+        }
+        // Written straight to the file descriptor, not through out
+        if (!exportCatalog(*catalogs.acquire(), exportFormat, exportPath)) {
+            return 1;
+        }
+        return metricsPath.empty() || writeMetricsFile(metricsPath, lastLoad) ? 0 : 1;
     }
 
-    const Course& c = it->second;
-    std::cout << std::endl;
-    std::cout << c.id << ": " << c.title << std::endl;
-
-    if (c.prereqs.empty()) {
-        std::cout << "Prerequisites: None" << std::endl;
-    } else {
-        std::cout << "Prerequisites:" << std::endl;
-        for (const std::string& pid : c.prereqs) {
-            auto pit = courses.find(pid);
-            if (pit != courses.end() && !pit->second.title.empty()) {
-                std::cout << "  - " << pit->second.id << ": " << pit->second.title << std::endl;
+    if (!serveCatalog.empty()) {
+#ifdef ABCU_HAVE_EPOLL
+        if (!loadForCommand(catalogs, serveCatalog, loadOptions, memoryReport)) {
+            return 1;
+        }
+        // SIGHUP reloads the same file; problems are reported and the old version kept
+        CatalogServer server(catalogs, serverOptions, [&catalogs, &serveCatalog, &loadOptions, memoryReport] {
+            CatalogDiff reloadDiff;
+            if (!loadForCommand(catalogs, serveCatalog, loadOptions, memoryReport, &reloadDiff)) {
+                std::cerr << "Keeping the previously loaded data." << std::endl;
+                return;
+            }
+            if (reloadDiff.full) {
+                std::cerr << "Reloaded " << serveCatalog << ": catalog rebuilt from scratch" << std::endl;
             } else {
-                std::cout << "  - " << pid << ": Title unknown" << std::endl;
+                std::cerr << "Reloaded " << serveCatalog << ": " << reloadDiff.added.size() << " added, "
+                          << reloadDiff.updated.size() << " updated, " << reloadDiff.removed.size() << " removed"
+                          << std::endl;
             }
+        });
+        if (!server.run()) {
+            return 1;
         }
+        return metricsPath.empty() || writeMetricsFile(metricsPath, lastLoad) ? 0 : 1;
+#else
+        std::cerr << "Error: --serve needs Linux (epoll)" << std::endl;
+        return 1;
+#endif
     }
-    std::cout << std::endl;
-}
 
-// Read a line safely from std::cin into s; return false on EOF
-bool safeGetline(std::string& s) {
-    if (!std::getline(std::cin, s)) {
-        return false;
-    }
-    // Trim carriage return if present (Windows CRLF handling)
-    if (!s.empty() && s.back() == '\r') {
-        s.pop_back();
-    }
-    return true;
-}
-
-// Display the main menu
-void showMenu() {
-    std::cout << std::endl;
-    std::cout << "Welcome to the ABCU Computer Science Advising Assistant" << std::endl;
-    std::cout << "--------------------------------------------------------" << std::endl;
-    std::cout << "  1. Load Data Structure" << std::endl;
-    std::cout << "  2. Print Course List" << std::endl;
-    std::cout << "  3. Print Course" << std::endl;
-    std::cout << "  9. Exit" << std::endl;
-    std::cout << std::endl;
-    std::cout << "What would you like to do? " << std::endl;
-}
-
-int main() {
-    std::map<std::string, Course> courses;
+    // The version this session is reading, and the derived data built over it
+    std::shared_ptr<const Catalog> catalog;
+    std::unique_ptr<PrereqClosure> closure;
+    ReachabilityIndex reach;
+    TitleIndex titles;
     bool dataLoaded = false;
 
     while (true) {
-        showMenu();
+        showMenu(out);
         std::string choiceLine;
         if (!safeGetline(choiceLine)) {
-            std::cout << std::endl << "Input closed. Exiting." << std::endl;
+            out << '\n' << "Input closed. Exiting." << '\n';
             break;
         }
         choiceLine = trim(choiceLine);
         if (choiceLine.empty()) {
-            std::cout << "Please enter a menu option (1, 2, 3, or 9)." << std::endl;
+            out << "Please enter a menu option (1, 2, 3, 4, 5, 6, 7, 8, or 9)." << '\n';
             continue;
         }
 
@@ -257,63 +509,202 @@ int main() {
             }
         }
         if (!numeric) {
-            std::cout << "Invalid option. Please enter 1, 2, 3, or 9." << std::endl;
+            out << "Invalid option. Please enter 1, 2, 3, 4, 5, 6, 7, 8, or 9." << '\n';
             continue;
         }
 
         int choice = std::stoi(choiceLine);
         if (choice == 1) {
-            std::cout << "Enter the file name to load: " << std::endl;
+            prompt(out, "Enter the file name to load: ");
             std::string filename;
             if (!safeGetline(filename)) {
-                std::cout << std::endl << "Input closed. Exiting." << std::endl;
+                out << '\n' << "Input closed. Exiting." << '\n';
                 break;
             }
             filename = trim(filename);
             if (filename.empty()) {
-                std::cout << "Error: file name cannot be empty." << std::endl;
+                out << "Error: file name cannot be empty." << '\n';
                 continue;
             }
 
             std::vector<std::string> warnings;
-            bool ok = loadCoursesFromFile(filename, courses, warnings);
+            std::string changes;
+            CatalogDiff diff;
+            bool ok = catalogs.load(filename, warnings, diff, loadOptions);
             if (ok) {
+                // The new version was built beside the one we hold; move over to it
+                std::shared_ptr<const Catalog> next = catalogs.acquire();
+                auto nextClosure = std::make_unique<PrereqClosure>(*next);
+                bool graphChanged = diff.full || next->size() != catalog->size() ||
+                                    std::find(diff.graphChanged.begin(), diff.graphChanged.end(), true) !=
+                                        diff.graphChanged.end();
+                if (!diff.full) {
+                    nextClosure->carryOver(*closure, diff.graphChanged);
+                }
+                if (graphChanged) {
+                    reach.clear(); // rebuilt on next use
+                }
+                catalog.swap(next);
+                closure.swap(nextClosure);
+                // Postings are sorted-order ranks, so an unchanged catalog keeps its index
+                if (diff.full || !diff.empty()) {
+                    titles.build(*catalog);
+                }
+
+                if (dataLoaded && diff.full) {
+                    changes = "Catalog rebuilt from scratch.";
+                } else if (dataLoaded && diff.empty()) {
+                    changes = "No course changes since the last load.";
+                } else if (dataLoaded) {
+                    changes = "Changes: " + std::to_string(diff.added.size()) + " added, " +
+                              std::to_string(diff.updated.size()) + " updated, " +
+                              std::to_string(diff.removed.size()) + " removed.";
+                }
                 dataLoaded = true;
-                std::cout << "Data loaded successfully from " << filename << std::endl;
+            } else if (dataLoaded) {
+                out << "Keeping the previously loaded data." << '\n';
+            }
+            if (ok) {
+                out << "Data loaded successfully from " << filename << '\n';
+#ifdef ABCU_ENABLE_METRICS
+                printLoadMetrics(lastLoad, out);
+#endif
+                if (!changes.empty()) {
+                    out << changes << '\n';
+                }
                 if (!warnings.empty()) {
-                    std::cout << "Note: Some lines were skipped or had issues:" << std::endl;
+                    out << "Note: Some lines were skipped or had issues:" << '\n';
                     for (const std::string& w : warnings) {
-                        std::cout << "  - " << w << std::endl;
+                        out << "  - " << w << '\n';
                     }
                 }
-            } else {
-                dataLoaded = false;
+                if (memoryReport) {
+                    MemoryReport memory;
+                    memory.catalog = catalog->memoryUsage();
+                    memory.titleIndexBytes = titles.memoryBytes();
+                    memory.reachabilityBytes = reach.memoryBytes();
+                    memory.closureBytes = closure->memoryBytes();
+                    memory.warningBytes = warningBytes(warnings);
+                    printMemoryReport(memory, out);
+                }
             }
         } else if (choice == 2) {
             if (!dataLoaded) {
-                std::cout << "Please load data first using option 1." << std::endl;
+                out << "Please load data first using option 1." << '\n';
                 continue;
             }
-            printSortedCourseList(courses);
+            printSortedCourseList(*catalog, out);
         } else if (choice == 3) {
             if (!dataLoaded) {
-                std::cout << "Please load data first using option 1." << std::endl;
+                out << "Please load data first using option 1." << '\n';
+                continue;
+            }
+            prompt(out, "Enter a course ID (e.g., CSCI300): ");
+            std::string query;
+            if (!safeGetline(query)) {
+                out << '\n' << "Input closed. Exiting." << '\n';
+                break;
+            }
+            printCourseInfo(*catalog, query, out);
+        } else if (choice == 4) {
+            if (!dataLoaded) {
+                out << "Please load data first using option 1." << '\n';
                 continue;
             }
-            std::cout << "Enter a course ID (e.g., CSCI300): " << std::endl;
+            prompt(out, "Enter a course ID (e.g., CSCI300): ");
             std::string query;
             if (!safeGetline(query)) {
-                std::cout << std::endl << "Input closed. Exiting." << std::endl;
+                out << '\n' << "Input closed. Exiting." << '\n';
+                break;
+            }
+            printFullPrerequisites(*catalog, *closure, query, out);
+        } else if (choice == 5) {
+            if (!dataLoaded) {
+                out << "Please load data first using option 1." << '\n';
+                continue;
+            }
+            prompt(out, "Enter the course ID to check (e.g., CSCI300): ");
+            std::string courseQuery;
+            if (!safeGetline(courseQuery)) {
+                out << '\n' << "Input closed. Exiting." << '\n';
+                break;
+            }
+            prompt(out, "Enter the possible prerequisite (e.g., CSCI100): ");
+            std::string prereqQuery;
+            if (!safeGetline(prereqQuery)) {
+                out << '\n' << "Input closed. Exiting." << '\n';
+                break;
+            }
+            // Build the bitset index on first use when it fits the budget
+            if (!reach.built() && ReachabilityIndex::estimateBytes(catalog->size()) <= reachBudgetBytes) {
+                reach.build(*catalog);
+            }
+            printRequirementCheck(*catalog, *closure, reach, courseQuery, prereqQuery, out);
+        } else if (choice == 6) {
+            if (!dataLoaded) {
+                out << "Please load data first using option 1." << '\n';
+                continue;
+            }
+            prompt(out, "Enter the target course IDs, separated by commas or spaces: ");
+            std::string targetsLine;
+            if (!safeGetline(targetsLine)) {
+                out << '\n' << "Input closed. Exiting." << '\n';
                 break;
             }
-            printCourseInfo(courses, query);
+            prompt(out, "Maximum courses per term (blank for " + std::to_string(planOptions.maxPerTerm) + "): ");
+            std::string capLine;
+            if (!safeGetline(capLine)) {
+                out << '\n' << "Input closed. Exiting." << '\n';
+                break;
+            }
+            PlanOptions options = planOptions;
+            capLine = trim(capLine);
+            if (!capLine.empty()) {
+                if (capLine.size() > 4 || !std::all_of(capLine.begin(), capLine.end(), [](char ch) {
+                        return std::isdigit(static_cast<unsigned char>(ch)) != 0;
+                    })) {
+                    out << "Error: the term cap must be a whole number." << '\n';
+                    continue;
+                }
+                options.maxPerTerm = static_cast<size_t>(std::stoi(capLine));
+            }
+
+            std::vector<std::string> unknown;
+            std::vector<uint32_t> targets = parseCourseList(*catalog, targetsLine, unknown);
+            for (const std::string& id : unknown) {
+                out << "Course not found: " << id << '\n';
+            }
+            if (targets.empty()) {
+                out << "Error: no valid target courses." << '\n';
+                continue;
+            }
+            printSemesterPlan(*catalog, planSemesters(*catalog, targets, options), out);
+        } else if (choice == 7) {
+            if (!dataLoaded) {
+                out << "Please load data first using option 1." << '\n';
+                continue;
+            }
+            prompt(out, "Enter words to search course titles for (e.g., data structures): ");
+            std::string query;
+            if (!safeGetline(query)) {
+                out << '\n' << "Input closed. Exiting." << '\n';
+                break;
+            }
+            printTitleSearch(*catalog, titles, query, out);
+        } else if (choice == 8) {
+            if (!dataLoaded) {
+                out << "Please load data first using option 1." << '\n';
+                continue;
+            }
+            printValidationReport(*catalog, validateCatalog(*catalog), out);
         } else if (choice == 9) {
-            std::cout << "Thank you for using the ABCU CS Advising Assistant. Goodbye!" << std::endl;
+            out << "Thank you for using the ABCU CS Advising Assistant. Goodbye!" << '\n';
             break;
         } else {
-            std::cout << "Invalid option. Please enter 1, 2, 3, or 9." << std::endl;
+            out << "Invalid option. Please enter 1, 2, 3, 4, 5, 6, 7, 8, or 9." << '\n';
         }
     }
 
-    return 0;
+    out.flush();
+    return metricsPath.empty() || writeMetricsFile(metricsPath, lastLoad) ? 0 : 1;
 }
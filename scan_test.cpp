@@ -0,0 +1,215 @@
+// ABCU field scanner cross-check
+// - Splits lines through splitFields with the vector scanner (findEither) and
+//   the scalar reference (findEitherScalar) and requires identical fields
+// - Also compares both with a byte-at-a-time splitter written from the format rules
+// - Covers quotes, "" escapes, delimiters on and around 16/32-byte block edges,
+//   lines shorter than one vector, trailing delimiters, and random lines
+// - Runs each case at every start offset within a block, so loads are unaligned too
+// - Exits 1 and prints the first differing line when any path disagrees
+//
+// Build: g++ -std=c++17 -O2 scan_test.cpp -o scan_test          (SSE2 path)
+//        g++ -std=c++17 -O2 -mavx2 scan_test.cpp -o scan_test   (AVX2 path)
+// Run:   ./scan_test [--random N] [--seed S]
+
+#include "catalog.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Start offsets tried for every line, covering every alignment of a 32-byte block
+static const size_t kOffsets = 32;
+
+// Split line one byte at a time: the delimiter separates fields outside
+// quotes, a quote toggles quoting, and quoted fields are decoded and trimmed
+// the way the loader does. Independent of both scanners.
+template <typename Dialect>
+static std::vector<std::string> referenceSplit(std::string_view line) {
+    std::vector<std::string> fields;
+    size_t fieldStart = 0;
+    bool inQuotes = false;
+    bool hasQuote = false;
+    for (size_t i = 0; i <= line.size(); ++i) {
+        bool atEnd = i == line.size();
+        if (!atEnd && Dialect::quote != '\0' && line[i] == Dialect::quote) {
+            inQuotes = !inQuotes;
+            hasQuote = true;
+            continue;
+        }
+        if (atEnd || (line[i] == Dialect::delimiter && !inQuotes)) {
+            std::string_view raw = line.substr(fieldStart, i - fieldStart);
+            std::string field;
+            if (hasQuote) {
+                decodeQuotedField(raw, field, Dialect::quote);
+            } else {
+                field.assign(raw.data(), raw.size());
+            }
+            fields.push_back(Dialect::trim ? std::string(trimView(field)) : field);
+            fieldStart = i + 1;
+            hasQuote = false;
+        }
+    }
+    return fields;
+}
+
+template <typename Dialect>
+static std::vector<std::string> splitWith(std::string_view line, ScanFn scan) {
+    std::vector<std::string_view> views;
+    std::string scratch;
+    splitFields<Dialect>(line, views, scratch, scan);
+    return std::vector<std::string>(views.begin(), views.end());
+}
+
+static std::string showFields(const std::vector<std::string>& fields) {
+    std::string s;
+    for (const std::string& f : fields) {
+        s += "[" + f + "]";
+    }
+    return s;
+}
+
+struct Checker {
+    size_t lines = 0;
+    size_t failures = 0;
+
+    // Check line at every start offset, through one dialect
+    template <typename Dialect>
+    void check(const std::string& line, const char* dialect) {
+        std::string buffer(kOffsets + line.size(), '#');
+        for (size_t offset = 0; offset < kOffsets; ++offset) {
+            buffer.replace(offset, line.size(), line);
+            std::string_view view(buffer.data() + offset, line.size());
+            std::vector<std::string> vector = splitWith<Dialect>(view, findEither);
+            std::vector<std::string> scalar = splitWith<Dialect>(view, findEitherScalar);
+            std::vector<std::string> reference = referenceSplit<Dialect>(view);
+            ++lines;
+            if (vector != scalar || scalar != reference) {
+                if (++failures == 1) {
+                    std::cerr << "Mismatch (" << dialect << ", offset " << offset << ") for line: " << line << '\n'
+                              << "  vector:    " << showFields(vector) << '\n'
+                              << "  scalar:    " << showFields(scalar) << '\n'
+                              << "  reference: " << showFields(reference) << std::endl;
+                }
+            }
+            buffer.replace(offset, line.size(), std::string(line.size(), '#'));
+        }
+    }
+
+    void checkAll(const std::string& line) {
+        check<CommaDialect>(line, "comma");
+        check<TabDialect>(line, "tab");
+        check<PipeDialect>(line, "pipe");
+    }
+};
+
+// Lines built around the vector block size: the interesting byte at each
+// position from one before to one after every 16- and 32-byte edge
+static void checkBlockEdges(Checker& checker) {
+    const char specials[] = {',', '"', '\t', '|'};
+    for (size_t length = 0; length <= 70; ++length) {
+        checker.checkAll(std::string(length, 'x'));
+        for (size_t pos = 0; pos < length; ++pos) {
+            bool nearEdge = pos < 2 || pos + 2 >= length || pos % 16 <= 1 || pos % 16 == 15;
+            if (!nearEdge) {
+                continue;
+            }
+            for (char c : specials) {
+                std::string line(length, 'x');
+                line[pos] = c;
+                checker.checkAll(line);
+            }
+            // A quoted field opening before the edge and closing after it, and a "" escape on it
+            std::string quoted(length, 'x');
+            quoted[pos] = '"';
+            quoted[length - 1] = '"';
+            checker.checkAll(quoted);
+            if (pos + 1 < length) {
+                std::string escaped(length, 'x');
+                escaped[0] = '"';
+                escaped[pos] = '"';
+                escaped[pos + 1] = '"';
+                escaped[length - 1] = '"';
+                checker.checkAll(escaped);
+            }
+        }
+    }
+}
+
+// Hand-written lines around quoting and trailing delimiters
+static void checkKnownLines(Checker& checker) {
+    const char* lines[] = {
+        "",
+        ",",
+        ",,",
+        "CSCI100,Intro to CS,",
+        "CSCI100,Intro to CS,MATH101,",
+        "CSCI100,\"Intro, with comma\",MATH101",
+        "CSCI100,\"He said \"\"hi\"\"\",MATH101",
+        "\"\"",
+        "\"\"\"\"",
+        "\"unterminated, quote",
+        "a\"b\"c,d",
+        " CSCI100 , Intro , MATH101 ",
+        "CSCI100\tIntro, Part I\tMATH101\t",
+        "CSCI100|Intro|MATH101|",
+        "CSCI300,\"Data Structures, Part II: Trees and Graphs and a title long enough\",CSCI200,MATH201,",
+    };
+    for (const char* line : lines) {
+        checker.checkAll(line);
+    }
+}
+
+// Random lines over a small alphabet, so delimiters, quotes and escapes are dense
+static void checkRandomLines(Checker& checker, size_t count, uint32_t seed) {
+    const char alphabet[] = {'a', 'b', ' ', ',', ',', '"', '"', '\t', '|', 'Z'};
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> lengthOf(0, 200);
+    std::uniform_int_distribution<size_t> charOf(0, sizeof alphabet - 1);
+    for (size_t i = 0; i < count; ++i) {
+        std::string line(lengthOf(rng), 'a');
+        for (char& c : line) {
+            c = alphabet[charOf(rng)];
+        }
+        checker.checkAll(line);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t randomLines = 20000;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--random" && i + 1 < argc) {
+            randomLines = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--random N] [--seed S]" << std::endl;
+            return 1;
+        }
+    }
+
+    Checker checker;
+    checkKnownLines(checker);
+    checkBlockEdges(checker);
+    checkRandomLines(checker, randomLines, seed);
+#ifdef ABCU_HAVE_SIMD
+#ifdef __AVX2__
+    const char* path = "AVX2";
+#else
+    const char* path = "SSE2";
+#endif
+#else
+    const char* path = "scalar only";
+#endif
+    if (checker.failures != 0) {
+        std::cerr << checker.failures << " of " << checker.lines << " splits disagree (" << path << ")" << std::endl;
+        return 1;
+    }
+    std::printf("%zu splits agree (%s)\n", checker.lines, path);
+    return 0;
+}
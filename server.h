@@ -0,0 +1,745 @@
+// ABCU catalog query server (header-only, Linux)
+// - Answers course, prerequisite-chain and list queries over TCP with a line protocol
+// - One epoll event loop owns every socket; a pool of worker threads renders responses
+// - Clients may pipeline requests; each connection gets its responses in request order
+// - COURSE and CHAIN take several IDs per request
+// - Workers read the published catalog version, shared read-only between them
+// - Per-endpoint latency histograms are served as JSON (STATS)
+// - Rendered COURSE answers are cached per course (CourseInfoCache) until the next reload
+// - SIGHUP reloads the catalog in the background; requests keep being answered meanwhile
+//
+// Protocol: one request per line (LF or CRLF); IDs are separated by spaces or commas.
+//   COURSE ID [ID ...]  course and direct prerequisites, exactly as printCourseInfo renders them
+//   CHAIN ID [ID ...]   full prerequisite chain, as printFullPrerequisites renders it
+//   LIST                every course in ID order, as printSortedCourseList renders it
+//   STATS               latency histograms per endpoint and cache counters, as JSON
+//   QUIT                close the connection once earlier requests are answered
+// Every response is "OK <bytes>\n" followed by that many bytes of text,
+// or a single "ERR <message>\n" line.
+
+#ifndef ABCU_SERVER_H
+#define ABCU_SERVER_H
+
+#include "catalog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#define ABCU_HAVE_EPOLL 1
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Request latencies in power-of-two microsecond buckets: bucket 0 counts
+// requests under 1 us, bucket i those from 2^(i-1) up to 2^i us, and the
+// last bucket everything slower. Safe to record from any thread.
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 24;
+
+    void record(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        size_t bucket = 0;
+        while (bucket + 1 < kBuckets && (uint64_t(1) << bucket) <= us) {
+            ++bucket;
+        }
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        totalNs_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // {"count": N, "mean_us": M, "p50_us": ..., "buckets": [...]}; percentiles
+    // are bucket upper bounds
+    std::string json() const {
+        uint64_t counts[kBuckets];
+        for (size_t b = 0; b < kBuckets; ++b) {
+            counts[b] = buckets_[b].load(std::memory_order_relaxed);
+        }
+        uint64_t count = count_.load(std::memory_order_relaxed);
+        uint64_t mean = count == 0 ? 0 : totalNs_.load(std::memory_order_relaxed) / count / 1000;
+        std::string s = "{\"count\": " + std::to_string(count) + ", \"mean_us\": " + std::to_string(mean);
+        s += ", \"p50_us\": " + std::to_string(percentileUs(counts, count, 0.50));
+        s += ", \"p90_us\": " + std::to_string(percentileUs(counts, count, 0.90));
+        s += ", \"p99_us\": " + std::to_string(percentileUs(counts, count, 0.99));
+        s += ", \"buckets\": [";
+        for (size_t b = 0; b < kBuckets; ++b) {
+            s += (b == 0 ? "" : ", ") + std::to_string(counts[b]);
+        }
+        return s + "]}";
+    }
+
+private:
+    static uint64_t percentileUs(const uint64_t* counts, uint64_t count, double p) {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(p * static_cast<double>(count) + 0.5);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kBuckets; ++b) {
+            seen += counts[b];
+            if (seen >= std::max<uint64_t>(target, 1)) {
+                return uint64_t(1) << b;
+            }
+        }
+        return uint64_t(1) << (kBuckets - 1);
+    }
+
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> totalNs_{0};
+};
+
+enum class Endpoint { Course, Chain, List, Stats, Quit, Unknown };
+
+// Request kinds, matched case-insensitively
+inline Endpoint parseEndpoint(std::string_view command) {
+    std::string upper = toUpper(command);
+    if (upper == "COURSE") {
+        return Endpoint::Course;
+    } else if (upper == "CHAIN") {
+        return Endpoint::Chain;
+    } else if (upper == "LIST") {
+        return Endpoint::List;
+    } else if (upper == "STATS") {
+        return Endpoint::Stats;
+    } else if (upper == "QUIT") {
+        return Endpoint::Quit;
+    }
+    return Endpoint::Unknown;
+}
+
+// Latency of each endpoint since the server started
+struct ServerStats {
+    LatencyHistogram course;
+    LatencyHistogram chain;
+    LatencyHistogram list;
+    LatencyHistogram stats;
+    std::atomic<uint64_t> errors{0}; // requests answered with ERR
+
+    LatencyHistogram* histogram(Endpoint endpoint) {
+        switch (endpoint) {
+        case Endpoint::Course:
+            return &course;
+        case Endpoint::Chain:
+            return &chain;
+        case Endpoint::List:
+            return &list;
+        case Endpoint::Stats:
+            return &stats;
+        default:
+            return nullptr;
+        }
+    }
+
+    // cache may be null when the server runs without one
+    std::string json(CourseInfoCache* cache) const {
+        std::string s = "{\"course\": " + course.json() + ", \"chain\": " + chain.json() +
+                        ", \"list\": " + list.json() + ", \"stats\": " + stats.json() +
+                        ", \"errors\": " + std::to_string(errors.load());
+        if (cache != nullptr) {
+            s += ", \"course_cache\": {\"hits\": " + std::to_string(cache->hits()) +
+                 ", \"misses\": " + std::to_string(cache->misses()) + ", \"entries\": " +
+                 std::to_string(cache->size()) + ", \"capacity\": " + std::to_string(cache->capacity()) +
+                 ", \"bytes\": " + std::to_string(cache->memoryBytes()) + "}";
+        }
+        return s + "}";
+    }
+};
+
+// std::streambuf that appends to a string, so OutputBuffer can render into memory
+class StringSink : public std::streambuf {
+public:
+    explicit StringSink(std::string& target) : target_(target) {}
+
+protected:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) {
+            target_.push_back(static_cast<char>(c));
+        }
+        return c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        target_.append(s, static_cast<size_t>(n));
+        return n;
+    }
+
+private:
+    std::string& target_;
+};
+
+// Answer one request line (not QUIT) into out, with the same renderers the
+// menu uses; cache (optional) serves repeated COURSE IDs. Returns the
+// endpoint that answered, or Unknown with error set.
+inline Endpoint answerRequest(const Catalog& catalog, PrereqClosure& closure, const ServerStats& stats,
+                              CourseInfoCache* cache, std::string_view line, OutputBuffer& out,
+                              std::string& error) {
+    line = trimView(line);
+    size_t space = line.find_first_of(" \t");
+    std::string_view command = line.substr(0, space);
+    std::string_view args = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+
+    Endpoint endpoint = parseEndpoint(command);
+    std::vector<std::string_view> ids;
+    size_t pos = 0;
+    while (pos < args.size()) {
+        size_t end = args.find_first_of(" \t,", pos);
+        if (end == std::string_view::npos) {
+            end = args.size();
+        }
+        if (end > pos) {
+            ids.push_back(args.substr(pos, end - pos));
+        }
+        pos = end + 1;
+    }
+
+    if (endpoint == Endpoint::Course || endpoint == Endpoint::Chain) {
+        if (ids.empty()) {
+            error = "expected one or more course IDs";
+            return Endpoint::Unknown;
+        }
+        for (std::string_view id : ids) {
+            if (endpoint == Endpoint::Course) {
+                printCourseInfo(catalog, id, out, cache);
+            } else {
+                printFullPrerequisites(catalog, closure, id, out);
+            }
+        }
+    } else if (endpoint == Endpoint::List) {
+        printSortedCourseList(catalog, out);
+    } else if (endpoint == Endpoint::Stats) {
+        out << stats.json(cache) << '\n';
+    } else {
+        error = "unknown request: " + std::string(command);
+    }
+    return error.empty() ? endpoint : Endpoint::Unknown;
+}
+
+// Options for CatalogServer
+struct ServerOptions {
+    std::string bind = "127.0.0.1";
+    uint16_t port = 7070;            // 0 picks a free port
+    size_t workers = 0;              // 0 means one per hardware thread
+    size_t maxLineBytes = 64 * 1024; // longer requests are refused and the connection closed
+    size_t maxPipelined = 256;       // unanswered requests per connection before reading pauses
+    size_t maxUnsentBytes = 4 << 20; // answers the client has not read yet before reading pauses
+    size_t cacheEntries = 4096;      // rendered COURSE answers kept; 0 disables the cache
+};
+
+#ifdef ABCU_HAVE_EPOLL
+
+// The query server. run() blocks until SIGINT or SIGTERM. The event loop
+// thread owns all connection state; workers only see the job and result
+// queues, and wake the loop through an eventfd when results are ready.
+// reload, when given, runs on its own thread after SIGHUP (one at a time)
+// and is expected to publish a new version through catalogs.
+class CatalogServer {
+public:
+    CatalogServer(CatalogPublisher& catalogs, const ServerOptions& options, std::function<void()> reload = {})
+        : catalogs_(catalogs), options_(options), reload_(std::move(reload)) {
+        if (options_.workers == 0) {
+            options_.workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (options_.cacheEntries != 0) {
+            cache_ = std::make_unique<CourseInfoCache>(options_.cacheEntries);
+        }
+    }
+
+    CatalogServer(const CatalogServer&) = delete;
+    CatalogServer& operator=(const CatalogServer&) = delete;
+
+    // Serve until stopped; false (with a message on stderr) if the server cannot start
+    bool run() {
+        if (!open()) {
+            closeAll();
+            return false;
+        }
+        std::cerr << "Serving on " << options_.bind << ":" << port_ << " with " << options_.workers << " workers"
+                  << std::endl;
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < options_.workers; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+        loop();
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex_);
+            stopping_ = true;
+        }
+        jobsReady_.notify_all();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+        if (reloader_.joinable()) {
+            reloader_.join();
+        }
+        closeAll();
+        return true;
+    }
+
+    const ServerStats& stats() const { return stats_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // epoll tags below kFirstConnection; connections are numbered from there
+    static constexpr uint64_t kListenTag = 0;
+    static constexpr uint64_t kWakeTag = 1;
+    static constexpr uint64_t kSignalTag = 2;
+    static constexpr uint64_t kFirstConnection = 3;
+
+    struct Job {
+        uint64_t connection;
+        uint64_t seq;
+        std::string line;
+        Clock::time_point received;
+    };
+
+    struct Result {
+        uint64_t connection;
+        uint64_t seq;
+        std::string response;
+    };
+
+    struct Connection {
+        int fd = -1;
+        std::string in;
+        std::string out;
+        size_t outSent = 0;
+        uint64_t nextSeq = 0;                   // assigned to the next request read
+        uint64_t nextSend = 0;                  // the response to write next
+        std::map<uint64_t, std::string> ready;  // finished out of order, waiting for nextSend
+        uint32_t events = 0;                    // currently registered with epoll
+        bool quitting = false;                  // QUIT seen or line too long: take no more requests
+        bool inputClosed = false;               // the client finished sending; answer what it sent
+        bool broken = false;                    // nobody left to answer
+    };
+
+    // Whether to take more requests from c: a client that does not read its
+    // answers, or pipelines faster than they are made, waits in its socket
+    bool accepting(const Connection& c) const {
+        return !c.quitting && !c.broken && c.nextSeq - c.nextSend < options_.maxPipelined &&
+               c.out.size() - c.outSent < options_.maxUnsentBytes;
+    }
+
+    bool open() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        if (reload_) {
+            sigaddset(&signals, SIGHUP);
+        }
+        // Blocked here, so the workers and reloads started after this inherit
+        // the mask and the signals arrive only through the signalfd
+        if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0) {
+            std::cerr << "Error: Could not block SIGINT and SIGTERM" << std::endl;
+            return false;
+        }
+        signalFd_ = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (signalFd_ < 0 || epollFd_ < 0 || wakeFd_ < 0 || listenFd_ < 0) {
+            std::cerr << "Error: Could not set up the server: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options_.port);
+        if (::inet_pton(AF_INET, options_.bind.c_str(), &address.sin_addr) != 1) {
+            std::cerr << "Error: Not an IPv4 address: " << options_.bind << std::endl;
+            return false;
+        }
+        int on = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, SOMAXCONN) != 0) {
+            std::cerr << "Error: Could not listen on " << options_.bind << ":" << options_.port << ": "
+                      << std::strerror(errno) << std::endl;
+            return false;
+        }
+        socklen_t length = sizeof(address);
+        ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+
+        return watch(listenFd_, kListenTag, EPOLLIN) && watch(wakeFd_, kWakeTag, EPOLLIN) &&
+               watch(signalFd_, kSignalTag, EPOLLIN);
+    }
+
+    bool watch(int fd, uint64_t tag, uint32_t events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = tag;
+        if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            std::cerr << "Error: epoll_ctl failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void closeAll() {
+        for (auto& entry : connections_) {
+            ::close(entry.second.fd);
+        }
+        connections_.clear();
+        for (int* fd : {&listenFd_, &wakeFd_, &signalFd_, &epollFd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+    void loop() {
+        epoll_event events[64];
+        for (;;) {
+            int n = ::epoll_wait(epollFd_, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Error: epoll_wait failed: " << std::strerror(errno) << std::endl;
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == kListenTag) {
+                    acceptAll();
+                } else if (tag == kWakeTag) {
+                    deliverResults();
+                } else if (tag == kSignalTag) {
+                    signalfd_siginfo info{};
+                    if (::read(signalFd_, &info, sizeof(info)) == sizeof(info) && info.ssi_signo == SIGHUP) {
+                        startReload();
+                        continue;
+                    }
+                    return;
+                } else {
+                    auto it = connections_.find(tag);
+                    if (it == connections_.end()) {
+                        continue; // closed earlier in this batch
+                    }
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                        it->second.broken = true;
+                    }
+                    if (events[i].events & EPOLLIN) {
+                        readFrom(it->second);
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        writeTo(it->second);
+                    }
+                    update(tag, it->second);
+                }
+            }
+        }
+    }
+
+    // SIGHUPs during a reload fold into one more reload after it, since the
+    // running one may have read the file before it changed
+    void startReload() {
+        {
+            std::lock_guard<std::mutex> lock(reloadMutex_);
+            if (reloading_) {
+                reloadAgain_ = true;
+                return;
+            }
+            reloading_ = true;
+        }
+        if (reloader_.joinable()) {
+            reloader_.join(); // finished: it cleared reloading_ on its way out
+        }
+        reloader_ = std::thread([this] {
+            for (;;) {
+                reload_();
+                std::lock_guard<std::mutex> lock(reloadMutex_);
+                if (!reloadAgain_) {
+                    reloading_ = false;
+                    return;
+                }
+                reloadAgain_ = false;
+            }
+        });
+    }
+
+    void acceptAll() {
+        for (;;) {
+            int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return; // EAGAIN, or a connection that went away before we got to it
+            }
+            uint64_t tag = nextConnection_++;
+            Connection& c = connections_[tag];
+            c.fd = fd;
+            c.events = EPOLLIN;
+            epoll_event event{};
+            event.events = c.events;
+            event.data.u64 = tag;
+            if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                connections_.erase(tag);
+            }
+        }
+    }
+
+    void readFrom(Connection& c) {
+        char buffer[64 * 1024];
+        while (accepting(c) && !c.inputClosed) {
+            ssize_t n = ::recv(c.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                c.in.append(buffer, static_cast<size_t>(n));
+                if (c.in.size() > options_.maxLineBytes) {
+                    break; // enough to work on; the rest waits in the socket
+                }
+            } else if (n == 0) {
+                c.inputClosed = true;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                c.broken = true;
+            }
+        }
+    }
+
+    // Turn complete lines into jobs until the pipeline is full
+    void dispatchLines(uint64_t tag, Connection& c) {
+        size_t start = 0;
+        bool queued = false;
+        while (accepting(c)) {
+            size_t newline = c.in.find('\n', start);
+            if (newline == std::string::npos && c.inputClosed && start < c.in.size()) {
+                newline = c.in.size(); // the last request may lack its newline
+            }
+            if (newline == std::string::npos) {
+                if (c.in.size() - start > options_.maxLineBytes) {
+                    c.quitting = true;
+                    stats_.errors.fetch_add(1, std::memory_order_relaxed);
+                    complete(c, c.nextSeq++, "ERR request line too long\n");
+                }
+                break;
+            }
+            std::string_view line(c.in.data() + start, newline - start);
+            start = std::min(newline + 1, c.in.size());
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (trimView(line).empty()) {
+                continue;
+            }
+            if (line.size() > options_.maxLineBytes) {
+                c.quitting = true;
+                stats_.errors.fetch_add(1, std::memory_order_relaxed);
+                complete(c, c.nextSeq++, "ERR request line too long\n");
+                break;
+            }
+            std::string_view command = trimView(line).substr(0, trimView(line).find_first_of(" \t"));
+            if (parseEndpoint(command) == Endpoint::Quit) {
+                c.quitting = true;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex_);
+                jobs_.push_back(Job{tag, c.nextSeq++, std::string(line), Clock::now()});
+            }
+            queued = true;
+        }
+        c.in.erase(0, start);
+        if (queued) {
+            jobsReady_.notify_all();
+        }
+    }
+
+    // Queue one response; everything now in order moves to the output buffer
+    void complete(Connection& c, uint64_t seq, std::string response) {
+        c.ready.emplace(seq, std::move(response));
+        for (auto it = c.ready.begin(); it != c.ready.end() && it->first == c.nextSend; it = c.ready.erase(it)) {
+            c.out += it->second;
+            ++c.nextSend;
+        }
+    }
+
+    void writeTo(Connection& c) {
+        while (c.outSent < c.out.size()) {
+            ssize_t n = ::send(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent, MSG_NOSIGNAL);
+            if (n > 0) {
+                c.outSent += static_cast<size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            } else {
+                c.broken = true;
+                c.out.clear();
+                c.outSent = 0;
+                return;
+            }
+        }
+        c.out.clear();
+        c.outSent = 0;
+    }
+
+    // After any activity: queue the lines that can go, write what is ready,
+    // then close the connection or adjust what epoll watches it for
+    void update(uint64_t tag, Connection& c) {
+        if (!c.broken) {
+            writeTo(c); // first, so a drained buffer lets waiting lines through
+            dispatchLines(tag, c);
+            writeTo(c);
+        }
+        bool pending = c.nextSeq != c.nextSend;
+        bool unsent = c.outSent < c.out.size();
+        // A broken connection goes at once, even with jobs still running: their
+        // results are dropped in deliverResults, and kept in epoll it would
+        // report HUP or ERR on every wait whatever its mask
+        if (c.broken || ((c.quitting || c.inputClosed) && !pending && !unsent)) {
+            ::close(c.fd); // also drops it from epoll
+            connections_.erase(tag);
+            return;
+        }
+        uint32_t events = 0;
+        if (accepting(c) && !c.inputClosed) {
+            events |= EPOLLIN;
+        }
+        if (unsent && !c.broken) {
+            events |= EPOLLOUT;
+        }
+        if (events != c.events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.u64 = tag;
+            ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &event);
+            c.events = events;
+        }
+    }
+
+    void deliverResults() {
+        uint64_t count = 0;
+        ssize_t ignored = ::read(wakeFd_, &count, sizeof(count));
+        (void)ignored;
+        std::vector<Result> results;
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex_);
+            results.swap(results_);
+        }
+        for (Result& r : results) {
+            auto it = connections_.find(r.connection);
+            if (it == connections_.end()) {
+                continue; // the client left before its answer was ready
+            }
+            complete(it->second, r.seq, std::move(r.response));
+        }
+        // Update each connection once, however many of its results arrived
+        for (const Result& r : results) {
+            auto it = connections_.find(r.connection);
+            if (it != connections_.end()) {
+                update(r.connection, it->second);
+            }
+        }
+    }
+
+    void workerLoop() {
+        std::string payload;
+        StringSink sink(payload);
+        std::ostream stream(&sink);
+        OutputBuffer out(stream);
+        // The closure memoizes as it answers, so each worker keeps its own
+        // over the version it last saw
+        std::shared_ptr<const Catalog> catalog;
+        std::unique_ptr<PrereqClosure> closure;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(jobsMutex_);
+                jobsReady_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            std::shared_ptr<const Catalog> current = catalogs_.acquire();
+            if (current != catalog) {
+                catalog = std::move(current);
+                closure = std::make_unique<PrereqClosure>(*catalog);
+            }
+
+            std::string error;
+            Endpoint endpoint = answerRequest(*catalog, *closure, stats_, cache_.get(), job.line, out, error);
+            out.flush();
+            std::string response;
+            if (endpoint == Endpoint::Unknown) {
+                stats_.errors.fetch_add(1, std::memory_order_relaxed);
+                response = "ERR " + error + "\n";
+            } else {
+                response.reserve(payload.size() + 24);
+                response = "OK " + std::to_string(payload.size()) + "\n";
+                response += payload;
+                stats_.histogram(endpoint)->record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - job.received).count()));
+            }
+            payload.clear();
+
+            {
+                std::lock_guard<std::mutex> lock(resultsMutex_);
+                results_.push_back(Result{job.connection, job.seq, std::move(response)});
+            }
+            uint64_t one = 1;
+            ssize_t ignored = ::write(wakeFd_, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    CatalogPublisher& catalogs_;
+    ServerOptions options_;
+    ServerStats stats_;
+    std::unique_ptr<CourseInfoCache> cache_;
+    std::function<void()> reload_;
+    std::thread reloader_;
+    std::mutex reloadMutex_;
+    bool reloading_ = false;
+    bool reloadAgain_ = false;
+    uint16_t port_ = 0;
+
+    int listenFd_ = -1;
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+    int signalFd_ = -1;
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t nextConnection_ = kFirstConnection;
+
+    std::mutex jobsMutex_;
+    std::condition_variable jobsReady_;
+    std::deque<Job> jobs_;
+    bool stopping_ = false;
+
+    std::mutex resultsMutex_;
+    std::vector<Result> results_;
+};
+
+#endif // ABCU_HAVE_EPOLL
+
+#endif // ABCU_SERVER_H